@@ -0,0 +1,78 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright 2021 Kevin E. Jordan
+**
+**  Name: arena.c
+**
+**  Description:
+**      This file provides functions that manage arenas. An arena hands out
+**      memory from large blocks, and all of the memory obtained from it is
+**      released at once by resetting the arena, so objects with a common
+**      lifetime need not be allocated and freed one at a time.
+**
+**  Licensed under the Apache License, Version 2.0 (the "License");
+**  you may not use this file except in compliance with the License.
+**  You may obtain a copy of the License at
+**
+**      http://www.apache.org/licenses/LICENSE-2.0
+**
+**  Unless required by applicable law or agreed to in writing, software
+**  distributed under the License is distributed on an "AS IS" BASIS,
+**  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**  See the License for the specific language governing permissions and
+**  limitations under the License.
+**
+**--------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calconst.h"
+#include "calproto.h"
+#include "caltypes.h"
+#include "services.h"
+
+/*
+**  arenaAllocate - allocate zeroed memory from an arena
+*/
+void *arenaAllocate(Arena *arena, int size) {
+    ArenaBlock *block;
+    int blockSize;
+    void *new;
+
+    size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    block = arena->current;
+    while (block != NULL && block->used + size > block->size) {
+        block = block->next;
+        if (block != NULL) block->used = 0;
+    }
+    if (block == NULL) {
+        blockSize = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+        block = (ArenaBlock *)allocate(sizeof(ArenaBlock) + blockSize);
+        block->data = (u8 *)(block + 1);
+        block->size = blockSize;
+        if (arena->current == NULL) {
+            arena->first = block;
+        }
+        else {
+            block->next = arena->current->next;
+            arena->current->next = block;
+        }
+        arena->blockCount += 1;
+    }
+    arena->current = block;
+    new = block->data + block->used;
+    block->used += size;
+    memset(new, 0, size);
+    return new;
+}
+
+/*
+**  arenaReset - release all memory allocated from an arena, retaining
+**  its blocks for reuse
+*/
+void arenaReset(Arena *arena) {
+    arena->current = arena->first;
+    if (arena->current != NULL) arena->current->used = 0;
+}
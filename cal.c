@@ -33,8 +33,58 @@
 #include "services.h"
 #if defined(__cos)
 #include <sys/syslog.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #endif
 
+#if !defined(__cos)
+typedef struct job {
+    pid_t pid;
+    int resultFd;                               // pipe carrying the JobResult
+    char *sourcePath;
+    FILE *listingFile;                          // destination of the job's listing, or NULL
+    int lineNumber;                             // listing line number when the job started
+    char listingPath[MAX_FILE_PATH_LENGTH+1];   // temporary listing, if listingFile not NULL
+    char objectPath[MAX_FILE_PATH_LENGTH+1];    // temporary object, if object file is shared
+} Job;
+
+typedef struct jobResult {
+    int errCount;
+    int warnCount;
+    u64 errorUnion;
+    int lineNumber;
+    long allocationCount;
+    long reallocationCount;
+    long imageReallocationCount;
+    long objectCacheHits;
+    long objectCacheMisses;
+    long microReferenceCount;
+    long relocationEntriesRemoved;
+    clock_t cpuTime;
+    AssemblyStats stats;
+} JobResult;
+
+typedef struct servedText {
+    char path[MAX_FILE_PATH_LENGTH+5];
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    time_t modified;
+} ServedText;
+
+static void copyObjectRecords(char *path);
+static void createTempFile(char *path);
+static void finishJob(void);
+static void scanTextOptions(int argc, char *argv[], bool *isImplicit, bool *isStacking);
+static void startJob(char *sourcePath);
+#endif
+static void assembleSource(char *sourcePath, bool isExtText);
+static void assembleSources(int argc, char *argv[], int textCount);
+static int  findNextSource(int argi, int argc, char *argv[], bool *isExtText);
+static bool isFlagOption(char *option);
 static FILE *openExtText(char *fileName);
 static int  openNextSource(int argi, int argc, char *argv[], bool *isExtText);
 static void parseOptions(int argc, char *argv[]);
@@ -48,10 +98,26 @@ static void usage(void);
 static void writeObjectCode(void);
 
 static u16 defaultListControl = LIST_ON|LIST_XRF|LIST_XNS|LIST_WEM|LIST_WMR;
+static int errCount = 0;
 static char *explicitIdent = NULL;
+static bool isVerbose = FALSE;
 static char *lFile = NULL;
 static char *oFile = NULL;
 static char *textPath = NULL;
+static int warnCount = 0;
+#if !defined(__cos)
+static int firstJob = 0;
+static bool isStatsReported = FALSE;
+static int jobCount = 0;
+static clock_t jobCpuTime = 0;
+static int jobLimit = 1;
+static Job jobs[MAX_JOBS];
+static char *serverPath = NULL;
+static int servedTextCount = 0;
+static int servedTextLimit = 0;
+static ServedText *servedTexts = NULL;
+static char *statsPath = NULL;
+#endif
 
 #if defined(__cos)
 #define IS_KEY(s) (*((s) + strlen(s) - 1) == '=')
@@ -63,6 +129,7 @@ static char *textPath = NULL;
 #define R_KEY "R="
 #define S_KEY "S"
 #define T_KEY "T="
+#define V_KEY "V"
 #define W_KEY "W"
 #define X_KEY "X"
 #define STDOUT "$OUT"
@@ -76,86 +143,217 @@ static char *textPath = NULL;
 #define R_KEY "-r"
 #define S_KEY "-s"
 #define T_KEY "-t"
+#define V_KEY "-v"
 #define W_KEY "-w"
 #define X_KEY "-x"
 #define STDOUT "-"
 #endif
 
 int main(int argc, char *argv[], char *envp[]) {
-    ErrorCode code;
-    int errCount;
+    defaultModule = addModule("", 0);
+    readEnvars(envp);
+#if !defined(__cos)
+    if (argc == 3 && strcmp(argv[1], "--server") == 0) {
+        instInit();
+        serveJobs(argv[2]);
+    }
+    if (serverPath != NULL) requestJob(serverPath, textPath, argc, argv);
+#endif
+    instInit();
+    assembleSources(argc, argv, 0);
+    return 0;
+}
+
+#if !defined(__cos)
+/*
+**  assembleJob - assemble the source files of a job received by the assembly
+**                server, the first textCount external text files of which
+**                have been assembled already
+*/
+void assembleJob(int argc, char *argv[], char *jobTextPath, int textCount) {
+    textPath = jobTextPath;
+    assembleSources(argc, argv, textCount);
+}
+
+/*
+**  assembleJobText - assemble the external text files that precede the first
+**                    source file of a job received by the assembly server,
+**                    and return their number
+**
+**  The files are recorded so that isJobTextCurrent can recognize later jobs
+**  that name the same files, unchanged.
+*/
+int assembleJobText(int argc, char *argv[], char *jobTextPath) {
+    int argi;
     bool isExtText;
+    struct stat st;
+    ServedText *text;
+
+    textPath = jobTextPath;
+    scanTextOptions(argc, argv, &isImplicitExternals, &isSectionStackingEnabled);
+    argi = 1;
+    while (findNextSource(argi, argc, argv, &isExtText) >= 0 && isExtText) {
+        argi = openNextSource(argi, argc, argv, &isExtText);
+        if (servedTextCount >= servedTextLimit) {
+            servedTexts = (ServedText *)reallocate(servedTexts, servedTextLimit * sizeof(ServedText),
+                                                   (servedTextLimit + 8) * sizeof(ServedText));
+            servedTextLimit += 8;
+        }
+        text = &servedTexts[servedTextCount++];
+        strcpy(text->path, sourceFilePath);
+        if (fstat(fileno(sourceFile), &st) == 0) {
+            text->device = st.st_dev;
+            text->inode = st.st_ino;
+            text->size = st.st_size;
+            text->modified = st.st_mtime;
+        }
+        assembleSource(argv[argi - 1], TRUE);
+    }
+    return servedTextCount;
+}
+#endif
+
+/*
+**  assembleSource - assemble the source file most recently opened by openNextSource
+*/
+static void assembleSource(char *sourcePath, bool isExtText) {
+    bool isObjectCached;
+    bool isTextCached;
     Module *module;
     FILE *savedListingFile;
     Dataset *savedObjectFile;
     bool savedSyntaxIndicator;
-    int srcIndex;
-    int warnCount;
 
-    defaultModule = addModule("", 0);
-    readEnvars(envp);
-    parseOptions(argc, argv);
-    instInit();
-    errCount = 0;
-    srcIndex = 1;
-    warnCount = 0;
-
-    while (srcIndex < argc) {
-        srcIndex = openNextSource(srcIndex, argc, argv, &isExtText);
-        if (srcIndex < 0) break;
-        timeInit();
-        listInit();
-        firstModule = lastModule = NULL;
-        if (isExtText) {
-            savedListingFile = listingFile;
-            listingFile = NULL;
-            savedObjectFile = objectFile;
-            objectFile = NULL;
-            savedSyntaxIndicator = isFlexibleSyntax;
-            isFlexibleSyntax = FALSE;
-        }
+    loadSource();
+    fclose(sourceFile);
+    timeInit();
+    listInit();
+    firstModule = lastModule = NULL;
+    isObjectCached = FALSE;
+    if (isExtText) {
+        savedListingFile = listingFile;
+        listingFile = NULL;
+        savedObjectFile = objectFile;
+        objectFile = NULL;
+        savedSyntaxIndicator = isFlexibleSyntax;
+        isFlexibleSyntax = FALSE;
+        isTextCached = loadTextCache();
+    }
+    else {
+        invalidateTextCache();
+        isTextCached = FALSE;
+        isObjectCached = loadObjectCache(explicitIdent);
+    }
+    if (isObjectCached) {
+        clearErrorIndications();
+    }
+    else if (isTextCached) {
+        clearErrorIndications();
+    }
+    else {
+        startPhase(StatsPhase_Pass1);
         runPass(1, isExtText);
+        endPhase(StatsPhase_Pass1);
         for (module = firstModule; module != NULL; module = module->next) {
+            startPhase(StatsPhase_Literals);
             emitLiterals(module);
+            endPhase(StatsPhase_Literals);
+            startPhase(StatsPhase_ObjectBlocks);
             createObjectBlocks(module);
             adjustSymbolValues(module);
+            endPhase(StatsPhase_ObjectBlocks);
         }
+        startPhase(StatsPhase_Pass2);
         runPass(2, isExtText);
+        endPhase(StatsPhase_Pass2);
+        releaseFieldCache();
+        startPhase(StatsPhase_Literals);
         for (module = firstModule; module != NULL; module = module->next) {
             emitLiterals(module);
         }
-        errCount += getErrorCount();
-        warnCount += getWarningCount();
+        endPhase(StatsPhase_Literals);
+        recordTreeDepths();
+        if (isExtText) saveTextCache();
+    }
+    errCount += getErrorCount();
+    warnCount += getWarningCount();
+    if (isObjectCached == FALSE) {
+        startPhase(StatsPhase_Listing);
         listErrorSummary();
         listSymbolTable();
+        endPhase(StatsPhase_Listing);
+        startPhase(StatsPhase_ObjectCode);
         writeObjectCode();
-        fclose(sourceFile);
-        if (lFile == NULL && listingFile != NULL) {
-            fclose(listingFile);
-            listingFile = NULL;
-        }
-        if (oFile == NULL && objectFile != NULL) {
+        endPhase(StatsPhase_ObjectCode);
+    }
+    if (isExtText) {
+        addObjectCacheText();
+    }
+    else if (isObjectCached == FALSE) {
+        saveObjectCache();
+    }
+    releaseObjectSpills();
+    if (lFile == NULL && listingFile != NULL) {
+        fclose(listingFile);
+        listingFile = NULL;
+    }
+    if (oFile == NULL && objectFile != NULL) {
 #if defined(__cos)
-            if (cosDsClose(objectFile) == -1) {
-                eprintf("Failed to close object file for %s", argv[srcIndex - 1]);
-                exit(1);
-            }
+        if (cosDsClose(objectFile) == -1) {
+            eprintf("Failed to close object file for %s", sourcePath);
+            exit(1);
+        }
 #else
-            if (cosDsWriteEOF(objectFile) == -1
-                || cosDsWriteEOD(objectFile) == -1
-                || cosDsClose(objectFile) == -1) {
-                eprintf("Failed to write object file for %s", argv[srcIndex - 1]);
-                exit(1);
-            }
+        if (cosDsWriteEOF(objectFile) == -1
+            || cosDsWriteEOD(objectFile) == -1
+            || cosDsClose(objectFile) == -1) {
+            eprintf("Failed to write object file for %s", sourcePath);
+            exit(1);
+        }
 #endif
-            objectFile = NULL;
+        objectFile = NULL;
+    }
+    if (isExtText) {
+        listingFile = savedListingFile;
+        objectFile = savedObjectFile;
+        isFlexibleSyntax = savedSyntaxIndicator;
+    }
+}
+
+/*
+**  assembleSources - assemble the source files named by the command line,
+**                    skipping the first textCount external text files, and
+**                    exit
+*/
+static void assembleSources(int argc, char *argv[], int textCount) {
+    ErrorCode code;
+    double cpuSeconds;
+    FILE *fp;
+    bool isExtText;
+    int srcIndex;
+
+    parseOptions(argc, argv);
+    srcIndex = 1;
+
+    while (srcIndex < argc) {
+        srcIndex = openNextSource(srcIndex, argc, argv, &isExtText);
+        if (srcIndex < 0) break;
+        if (isExtText && textCount > 0) {
+            fclose(sourceFile);
+            textCount -= 1;
+            continue;
         }
-        if (isExtText) {
-            listingFile = savedListingFile;
-            objectFile = savedObjectFile;
-            isFlexibleSyntax = savedSyntaxIndicator;
+#if !defined(__cos)
+        if (jobLimit > 1 && isExtText == FALSE) {
+            startJob(argv[srcIndex - 1]);
+            continue;
         }
+#endif
+        assembleSource(argv[srcIndex - 1], isExtText);
     }
+#if !defined(__cos)
+    while (jobCount > 0) finishJob();
+#endif
     if (lFile != NULL && listingFile != NULL) fclose(listingFile);
     if (oFile != NULL && objectFile != NULL) {
 #if defined(__cos)
@@ -179,9 +377,207 @@ int main(int argc, char *argv[], char *envp[]) {
             eprintf("%-2s %s", getErrorIndicator(code), getErrorMessage(code));
         }
     }
+    if (isVerbose) {
+        eprintf("%ld allocations, %ld reallocations", allocationCount, reallocationCount);
+        eprintf("%ld object image reallocations", imageReallocationCount);
+        if (objectCacheDir != NULL) eprintf("%ld object cache hits, %ld misses", objectCacheHits, objectCacheMisses);
+        eprintf("%d line arena blocks, %d module arena blocks", lineArena.blockCount, moduleArena.blockCount);
+        cpuSeconds = (double)clock() / CLOCKS_PER_SEC;
+#if !defined(__cos)
+        cpuSeconds += (double)jobCpuTime / CLOCKS_PER_SEC;
+#endif
+        eprintf("%ld micro references resolved, %.0f per CPU second", microReferenceCount,
+                (cpuSeconds > 0.0) ? microReferenceCount / cpuSeconds : 0.0);
+    }
+#if !defined(__cos)
+    if (isStatsReported) reportStats(stderr);
+    if (statsPath != NULL) {
+        fp = fopen(statsPath, "w");
+        if (fp == NULL) {
+            perror(statsPath);
+            exit(1);
+        }
+        reportStatsJSON(fp);
+        fclose(fp);
+    }
+#endif
     exit(errCount > 0 || (warnCount > 0 && isFatalWarnings));
 }
 
+#if !defined(__cos)
+/*
+**  copyObjectRecords - append the records of a job's object dataset to the shared object file
+*/
+static void copyObjectRecords(char *path) {
+    Dataset *ds;
+
+    ds = cosDsOpen(path);
+    if (ds == NULL) {
+        perror(path);
+        exit(1);
+    }
+    if (cosDsCopyRecords(ds, objectFile) == -1) {
+        eprintf("Failed to copy %s to %s", path, oFile);
+        exit(1);
+    }
+    cosDsClose(ds);
+    unlink(path);
+}
+
+/*
+**  createTempFile - create an empty temporary file and return its path in path
+*/
+static void createTempFile(char *path) {
+    int fd;
+
+    strcpy(path, "/tmp/calXXXXXX");
+    fd = mkstemp(path);
+    if (fd == -1) {
+        perror(path);
+        exit(1);
+    }
+    close(fd);
+}
+
+/*
+**  finishJob - wait for the oldest assembly job to complete and merge its results
+*/
+static void finishJob(void) {
+    FILE *fp;
+    Job *job;
+    JobResult result;
+    int status;
+
+    job = &jobs[firstJob];
+    if (waitpid(job->pid, &status, 0) == -1) {
+        perror("waitpid");
+        exit(1);
+    }
+    if (read(job->resultFd, &result, sizeof(result)) != sizeof(result)
+        || WIFEXITED(status) == FALSE
+        || WEXITSTATUS(status) != 0) {
+        if (job->listingPath[0] != '\0') unlink(job->listingPath);
+        if (job->objectPath[0] != '\0') unlink(job->objectPath);
+        eprintf("Assembly of %s failed", job->sourcePath);
+        exit(1);
+    }
+    close(job->resultFd);
+    errCount += result.errCount;
+    warnCount += result.warnCount;
+    errorUnion = result.errorUnion;
+    allocationCount += result.allocationCount;
+    reallocationCount += result.reallocationCount;
+    imageReallocationCount += result.imageReallocationCount;
+    objectCacheHits += result.objectCacheHits;
+    objectCacheMisses += result.objectCacheMisses;
+    microReferenceCount += result.microReferenceCount;
+    relocationEntriesRemoved += result.relocationEntriesRemoved;
+    jobCpuTime += result.cpuTime;
+    mergeStats(&result.stats);
+    if (job->listingPath[0] != '\0') {
+        fp = fopen(job->listingPath, "r");
+        if (fp == NULL) {
+            perror(job->listingPath);
+            exit(1);
+        }
+        listMerge(fp, job->listingFile, job->lineNumber, result.lineNumber, FALSE);
+        fclose(fp);
+        unlink(job->listingPath);
+        if (lFile == NULL) fclose(job->listingFile);
+    }
+    if (job->objectPath[0] != '\0') copyObjectRecords(job->objectPath);
+    firstJob = (firstJob + 1) % MAX_JOBS;
+    jobCount -= 1;
+}
+#endif
+
+/*
+**  findNextSource - return the index of the command line argument naming the
+**                   next source or external text file, or -1 if none remains
+*/
+static int findNextSource(int argi, int argc, char *argv[], bool *isExtText) {
+    *isExtText = FALSE;
+    while (argi < argc) {
+        if (strcmp(argv[argi], I_KEY) == 0) {
+            argi += 1;
+            if (argi >= argc) break;
+            if (!IS_KEY(argv[argi])) return argi;
+        }
+        else if (strcmp(argv[argi], T_KEY) == 0) {
+            argi += 1;
+            if (argi >= argc) break;
+            if (!IS_KEY(argv[argi])) {
+                *isExtText = TRUE;
+                return argi;
+            }
+        }
+        else if (isFlagOption(argv[argi])) {
+            argi += 1;
+        }
+        else if (IS_KEY(argv[argi])) {
+            argi += 2;
+        }
+        else {
+            return argi;
+        }
+    }
+    return -1;
+}
+
+/*
+**  isFlagOption - determine whether a command line option takes no argument
+*/
+static bool isFlagOption(char *option) {
+    return strcmp(option, F_KEY) == 0
+        || strcmp(option, S_KEY) == 0
+        || strcmp(option, V_KEY) == 0
+        || strcmp(option, W_KEY) == 0
+        || strcmp(option, X_KEY) == 0
+#if !defined(__cos)
+        || strcmp(option, "-B") == 0
+        || strcmp(option, "-C") == 0
+        || strcmp(option, "-S") == 0
+#endif
+        ;
+}
+
+#if !defined(__cos)
+/*
+**  isJobTextCurrent - determine whether the external text files that precede
+**                     the first source file of a job received by the assembly
+**                     server are those assembled by assembleJobText, unchanged
+*/
+bool isJobTextCurrent(int argc, char *argv[], char *jobTextPath) {
+    int argi;
+    bool isExtText;
+    bool isImplicit;
+    bool isStacking;
+    int n;
+    struct stat st;
+    ServedText *text;
+
+    textPath = jobTextPath;
+    scanTextOptions(argc, argv, &isImplicit, &isStacking);
+    if (isImplicit != isImplicitExternals || isStacking != isSectionStackingEnabled) return FALSE;
+    argi = 1;
+    n = 0;
+    while (findNextSource(argi, argc, argv, &isExtText) >= 0 && isExtText) {
+        if (n >= servedTextCount) return FALSE;
+        argi = openNextSource(argi, argc, argv, &isExtText);
+        text = &servedTexts[n++];
+        if (fstat(fileno(sourceFile), &st) != 0
+            || strcmp(text->path, sourceFilePath) != 0
+            || st.st_dev != text->device || st.st_ino != text->inode
+            || st.st_size != text->size || st.st_mtime != text->modified) {
+            fclose(sourceFile);
+            return FALSE;
+        }
+        fclose(sourceFile);
+    }
+    return n == servedTextCount;
+}
+#endif
+
 static FILE *openExtText(char *fileName) {
     char *cp;
     char filePath[MAX_FILE_PATH_LENGTH+1];
@@ -217,44 +613,8 @@ static int openNextSource(int argi, int argc, char *argv[], bool *isExtText) {
     char *fp;
     char *limit;
 
-    *isExtText = FALSE;
-    while (argi < argc) {
-        if (strcmp(argv[argi], F_KEY) == 0) {
-            argi += 1;
-        }
-        else if (strcmp(argv[argi], I_KEY) == 0) {
-            argi += 1;
-            if (argi >= argc) break;
-            if (!IS_KEY(argv[argi])) {
-                *isExtText = FALSE;
-                break;
-            }
-        }
-        else if (strcmp(argv[argi], S_KEY) == 0) {
-            argi += 1;
-        }
-        else if (strcmp(argv[argi], T_KEY) == 0) {
-            argi += 1;
-            if (argi >= argc) break;
-            if (!IS_KEY(argv[argi])) {
-                *isExtText = TRUE;
-                break;
-            }
-        }
-        else if (strcmp(argv[argi], W_KEY) == 0) {
-            argi += 1;
-        }
-        else if (strcmp(argv[argi], X_KEY) == 0) {
-            argi += 1;
-        }
-        else if (IS_KEY(argv[argi])) {
-            argi += 2;
-        }
-        else {
-            break;
-        }
-    }
-    if (argi >= argc) return -1;
+    argi = findNextSource(argi, argc, argv, isExtText);
+    if (argi < 0) return -1;
     fp = filePath;
     limit = fp + MAX_FILE_PATH_LENGTH;
     dp = NULL;
@@ -278,7 +638,10 @@ static int openNextSource(int argi, int argc, char *argv[], bool *isExtText) {
     }
 #endif
     sourceFile = fopen(filePath, "r");
-    if (sourceFile == NULL) {
+    if (sourceFile != NULL) {
+        strcpy(sourceFilePath, filePath);
+    }
+    else {
         if (*isExtText) sourceFile = openExtText(filePath);
         if (sourceFile == NULL) {
             perror(filePath);
@@ -286,7 +649,6 @@ static int openNextSource(int argi, int argc, char *argv[], bool *isExtText) {
         }
     }
     if (*isExtText) return argi;
-    strcpy(sourceFilePath, filePath);
 
 #if defined(__cos)
     if (lFile == NULL) listingFile = stdout;
@@ -313,6 +675,9 @@ static int openNextSource(int argi, int argc, char *argv[], bool *isExtText) {
 
 static void parseOptions(int argc, char *argv[]) {
     char *cp;
+#if !defined(__cos)
+    FILE *fp;
+#endif
     Fnv32_t hash;
     int i;
     int len;
@@ -338,6 +703,12 @@ static void parseOptions(int argc, char *argv[]) {
                 usage();
             }
             lFile = argv[i];
+            //
+            //  The last listing file specified is the one written
+            //
+            if (listingFile != NULL && listingFile != stdout) fclose(listingFile);
+            listingFile = NULL;
+            listJournal(FALSE);
             if (strcmp(lFile, STDOUT) == 0) {
                 listingFile = stdout;
             }
@@ -347,6 +718,9 @@ static void parseOptions(int argc, char *argv[]) {
                     perror(lFile);
                     exit(1);
                 }
+#if !defined(__cos)
+                setvbuf(listingFile, NULL, _IOFBF, LISTING_BUFFER_SIZE);
+#endif
             }
         }
         else if (strcmp(argv[i], N_KEY) == 0) {
@@ -399,6 +773,12 @@ static void parseOptions(int argc, char *argv[]) {
             isSectionStackingEnabled = FALSE;
         }
 #if !defined(__cos)
+        else if (strcmp(argv[i], "-B") == 0) {
+            isObjectStreamed = TRUE;
+        }
+        else if (strcmp(argv[i], "-C") == 0) {
+            isRelocationCompacted = TRUE;
+        }
         else if (strcmp(argv[i], "-T") == 0) {
             i += 1;
             if (i >= argc || IS_KEY(argv[i])) {
@@ -406,6 +786,66 @@ static void parseOptions(int argc, char *argv[]) {
             }
             textPath = argv[i];
         }
+        else if (strcmp(argv[i], "-c") == 0) {
+            i += 1;
+            if (i >= argc || IS_KEY(argv[i])) {
+                usage();
+            }
+            objectCacheDir = argv[i];
+        }
+        else if (strcmp(argv[i], "-J") == 0) {
+            i += 1;
+            if (i >= argc || IS_KEY(argv[i])) {
+                usage();
+            }
+            statsPath = argv[i];
+        }
+        else if (strcmp(argv[i], "-L") == 0) {
+            i += 1;
+            if (i >= argc || IS_KEY(argv[i])) {
+                usage();
+            }
+            lFile = argv[i];
+            if (listingFile != NULL && listingFile != stdout) fclose(listingFile);
+            listingFile = fopen(lFile, "wb");
+            if (listingFile == NULL) {
+                perror(lFile);
+                exit(1);
+            }
+            setvbuf(listingFile, NULL, _IOFBF, LISTING_BUFFER_SIZE);
+            listJournal(TRUE);
+        }
+        else if (strcmp(argv[i], "-R") == 0) {
+            i += 1;
+            if (i >= argc || IS_KEY(argv[i])) {
+                usage();
+            }
+            fp = fopen(argv[i], "rb");
+            if (fp == NULL) {
+                perror(argv[i]);
+                exit(1);
+            }
+            setvbuf(stdout, NULL, _IOFBF, LISTING_BUFFER_SIZE);
+            if (listRender(fp, stdout) == -1) {
+                eprintf("%s is not a compressed listing", argv[i]);
+                exit(1);
+            }
+            fclose(fp);
+            exit(0);
+        }
+        else if (strcmp(argv[i], "-S") == 0) {
+            isStatsReported = TRUE;
+        }
+        else if (strcmp(argv[i], "-j") == 0) {
+            i += 1;
+            if (i >= argc || IS_KEY(argv[i])) {
+                usage();
+            }
+            jobLimit = atoi(argv[i]);
+            if (jobLimit < 1 || jobLimit > MAX_JOBS) {
+                usage();
+            }
+        }
 #endif
         else if (strcmp(argv[i], T_KEY) == 0) {
             i += 1;
@@ -413,6 +853,9 @@ static void parseOptions(int argc, char *argv[]) {
                 usage();
             }
         }
+        else if (strcmp(argv[i], V_KEY) == 0) {
+            isVerbose = TRUE;
+        }
         else if (strcmp(argv[i], W_KEY) == 0) {
             isFatalWarnings = TRUE;
         }
@@ -451,8 +894,12 @@ static void readEnvars(char *envp[]) {
         while (*cp != '\0' && *cp != '=') cp += 1;
         if (strncmp(env, "TEXTPATH", cp - env) == 0) {
             textPath = cp + 1;
-            break;
         }
+#if !defined(__cos)
+        else if (cp - env == strlen("CALSERVER") && strncmp(env, "CALSERVER", cp - env) == 0) {
+            serverPath = cp + 1;
+        }
+#endif
     }
 }
 
@@ -498,10 +945,7 @@ static int runPass(int passNo, bool isExtText) {
     resetDefaultModule();
     resetLocalSymbols();
     resetQualifierStack();
-    if (fseek(sourceFile, 0L, SEEK_SET) != 0) {
-        eputs("Failed to rewind source file");
-        exit(1);
-    }
+    rewindSource();
     if (explicitIdent != NULL && isExtText == FALSE) {
         if (pass == 1) {
             currentModule = addModule(explicitIdent, strlen(explicitIdent));
@@ -535,6 +979,136 @@ static int runPass(int passNo, bool isExtText) {
     return 0;
 }
 
+#if !defined(__cos)
+/*
+**  scanTextOptions - find the options of a job received by the assembly server
+**                    that influence the assembly of external text files, and
+**                    apply its text file directory list, if any
+*/
+static void scanTextOptions(int argc, char *argv[], bool *isImplicit, bool *isStacking) {
+    int i;
+
+    *isImplicit = FALSE;
+    *isStacking = TRUE;
+    i = 1;
+    while (i < argc) {
+        if (strcmp(argv[i], S_KEY) == 0) {
+            *isStacking = FALSE;
+        }
+        else if (strcmp(argv[i], X_KEY) == 0) {
+            *isImplicit = TRUE;
+        }
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            textPath = argv[++i];
+        }
+        else if (IS_KEY(argv[i]) && isFlagOption(argv[i]) == FALSE) {
+            i += 1;
+        }
+        i += 1;
+    }
+}
+
+/*
+**  startJob - start a child process that assembles the source file most
+**  recently opened by openNextSource
+*/
+static void startJob(char *sourcePath) {
+    int fds[2];
+    Job *job;
+    JobResult result;
+
+    if (jobCount >= jobLimit) finishJob();
+    job = &jobs[(firstJob + jobCount) % MAX_JOBS];
+    job->sourcePath = sourcePath;
+    job->listingFile = listingFile;
+    job->lineNumber = listLineNumber();
+    job->listingPath[0] = '\0';
+    job->objectPath[0] = '\0';
+    if (listingFile != NULL) createTempFile(job->listingPath);
+    if (oFile != NULL && objectFile != NULL) createTempFile(job->objectPath);
+    if (pipe(fds) == -1) {
+        perror("pipe");
+        exit(1);
+    }
+    fflush(NULL);
+    job->pid = fork();
+    if (job->pid == -1) {
+        perror("fork");
+        exit(1);
+    }
+    if (job->pid == 0) {
+        //
+        //  Child process. The listing and output destined for a shared
+        //  object file go to temporary files that the parent appends to
+        //  their destinations in command line order, renumbering listing
+        //  pages as it goes. The temporary listing is always text, and the
+        //  parent writes it to a journal (-L) as it appends it.
+        //
+        close(fds[0]);
+        if (job->listingPath[0] != '\0') {
+            listingFile = fopen(job->listingPath, "w");
+            if (listingFile == NULL) {
+                perror(job->listingPath);
+                exit(1);
+            }
+            listJournal(FALSE);
+        }
+        if (job->objectPath[0] != '\0') {
+            objectFile = cosDsCreate(job->objectPath);
+            if (objectFile == NULL) {
+                perror(job->objectPath);
+                exit(1);
+            }
+        }
+        errCount = warnCount = 0;
+        allocationCount = reallocationCount = imageReallocationCount = 0;
+        objectCacheHits = objectCacheMisses = 0;
+        microReferenceCount = relocationEntriesRemoved = 0;
+        memset(&assemblyStats, 0, sizeof(assemblyStats));
+        assembleSource(sourcePath, FALSE);
+        if (listingFile != NULL) fclose(listingFile);
+        if (job->objectPath[0] != '\0') {
+            if (cosDsWriteEOF(objectFile) == -1
+                || cosDsWriteEOD(objectFile) == -1
+                || cosDsClose(objectFile) == -1) {
+                eprintf("Failed to write object file for %s", sourcePath);
+                exit(1);
+            }
+        }
+        result.errCount = errCount;
+        result.warnCount = warnCount;
+        result.errorUnion = errorUnion;
+        result.lineNumber = listLineNumber();
+        result.allocationCount = allocationCount;
+        result.reallocationCount = reallocationCount;
+        result.imageReallocationCount = imageReallocationCount;
+        result.objectCacheHits = objectCacheHits;
+        result.objectCacheMisses = objectCacheMisses;
+        result.microReferenceCount = microReferenceCount;
+        result.relocationEntriesRemoved = relocationEntriesRemoved;
+        result.cpuTime = clock();
+        result.stats = assemblyStats;
+        if (write(fds[1], &result, sizeof(result)) != sizeof(result)) exit(1);
+        exit(0);
+    }
+    //
+    //  Parent process. The child owns the source file and any per-source
+    //  object file, so release them without writing. A per-source listing
+    //  file remains open until the job's listing is merged into it.
+    //
+    close(fds[1]);
+    job->resultFd = fds[0];
+    fclose(sourceFile);
+    if (lFile == NULL) listingFile = NULL;
+    if (oFile == NULL && objectFile != NULL) {
+        close(objectFile->fd);
+        free(objectFile);
+        objectFile = NULL;
+    }
+    jobCount += 1;
+}
+#endif
+
 static void timeInit(void) {
     time_t clock;
     struct tm *tmp;
@@ -550,7 +1124,7 @@ static void timeInit(void) {
 
 static void usage(void) {
 #if defined(__cos)
-    eputs("Usage: CAL[,B=ofile][,F][,I=sfile][,L=lfile][,N=ident][,T=tfile]...[,W][,X].");
+    eputs("Usage: CAL[,B=ofile][,F][,I=sfile][,L=lfile][,N=ident][,T=tfile]...[,V][,W][,X].");
     eputs("  B=ofile - object file");
     eputs("  F       - enable flexible syntax");
     eputs("  I=sfile - source file");
@@ -558,29 +1132,49 @@ static void usage(void) {
     eputs("  N=ident - default module identifier");
     eputs("  S       - disable section stacking");
     eputs("  T=tfile - external text file");
+    eputs("  V       - report memory allocation statistics");
     eputs("  W       - exit with error status on warning indications");
     eputs("  X       - enable implicit external symbols");
 #else
-    eputs("Usage: cal [-f][-l lfile][-n ident][-o ofile][-T dlist][-t tfile]...[-w][-x] sfile ...");
+    eputs("Usage: cal [-B][-C][-c cdir][-f][-J jfile][-j n][-L jfile][-l lfile][-n ident][-o ofile][-R jfile][-S][-T dlist][-t tfile]...[-v][-w][-x] sfile ...");
+    eputs("  -B       - stream object code, holding only part of each block in memory");
+    eputs("  -C       - sort relocation entries and remove duplicates");
+    eputs("  -c cdir  - object and text cache directory");
     eputs("  -f       - enable flexible syntax");
+    eputs("  -J jfile - write assembly statistics to jfile as JSON");
+    eputs("  -j n     - assemble up to n source files in parallel");
+    eputs("  -L jfile - write the listing to jfile compressed");
     eputs("  -l lfile - listing file");
     eputs("  -o ofile - object file");
+    eputs("  -R jfile - write the compressed listing jfile to stdout");
+    eputs("  -S       - report assembly statistics");
     eputs("  -s       - disable section stacking");
     eputs("  -T dlist - text file directory list");
     eputs("  -t tfile - external text file");
+    eputs("  -v       - report memory allocation, cache and micro statistics");
     eputs("  -w       - exit with error status on warning indications");
     eputs("  -x       - enable implicit external symbols");
     eputs("  sfile - source file(s)");
+    eputs("Usage: cal --server socket");
 #endif
     exit(1);
 }
 
 static void writeObjectCode(void) {
     Module *module;
+#if !defined(__cos)
+    long start;
+#endif
 
     if (objectFile != NULL) {
+#if !defined(__cos)
+        start = objectFile->bytesWritten + objectFile->cursor;
+#endif
         for (module = firstModule; module != NULL; module = module->next) {
             writeObjectRecord(module, objectFile);
         }
+#if !defined(__cos)
+        assemblyStats.objectBytesWritten += objectFile->bytesWritten + objectFile->cursor - start;
+#endif
     }
 }
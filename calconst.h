@@ -24,6 +24,8 @@
 **--------------------------------------------------------------------------
 */
 
+#define ARENA_ALIGNMENT          8
+#define ARENA_BLOCK_SIZE         65536
 #define ARG_STACK_SIZE           100
 #define BASE_STACK_SIZE          100
 #define BLOCK_STACK_SIZE         100
@@ -32,7 +34,10 @@
 #define EXTERN_TABLE_INCREMENT   100
 #define FALSE                    0
 #define IMAGE_INCREMENT          4096
+#define INSTRUCTION_INDEX_SIZE   128
+#define LISTING_BUFFER_SIZE      (256*1024)
 #define LIST_CONTROL_STACK_SIZE  100
+#define LITERAL_INDEX_SIZE       64
 #define MACRO_STACK_SIZE         100
 #define MASK6                    077
 #define MASK9                    0777
@@ -40,14 +45,22 @@
 #define MASK24                   077777777
 #define MAX_ERROR_INDICATIONS    7
 #define MAX_FILE_PATH_LENGTH     256
+#define MAX_JOBS                 64
 #define MAX_LOCAL_SYMBOLS        10
 #define MAX_NAME_LENGTH          8
 #define MAX_SOURCE_LINE_LENGTH   90
 #define MAX_TITLE_LENGTH         64
+#define MICRO_INDEX_SIZE         64
+#define OBJECT_WINDOW_SIZE       (512*1024)
 #define OP_STACK_SIZE            100
+#define PATTERN_INDEX_THRESHOLD  4
 #define QUALIFIER_STACK_SIZE     100
 #define RELOC_TABLE_INCREMENT    200
+#define SECTION_INDEX_SIZE       64
+#define SOURCE_BUFFER_INCREMENT  65536
 #define SOURCE_FORMAT_STACK_SIZE 100
+#define SOURCE_LINE_INCREMENT    1024
+#define SYMBOL_INDEX_SIZE        64
 #define TRUE                     1
 
 #endif
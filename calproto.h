@@ -29,12 +29,15 @@
 #include "caltypes.h"
 #include "cosdataset.h"
 
+extern int applyCompiledRE(CompiledRE *program, char *s, int sLen, char **captures, int *lenCaptures, int maxCaptures, int *nCaptures);
 extern int applyRE(char *re, int reLen, char *s, int sLen, char **captures, int *lenCaptures, int maxCaptures, int *nCaptures);
+extern AssemblyStats assemblyStats;
 extern int baseStack[];
 extern int baseStackPtr;
 extern char *calName;
 extern char *calVersion;
 extern u32 column;
+extern CompiledRE *compileRE(char *re, int reLen);
 extern int currentBase;
 extern Section *currentSection;
 extern char currentDate[];
@@ -54,11 +57,16 @@ extern EditControl editControlStack[];
 extern u32 errorCount;
 extern u64 errorUnion;
 extern Module *firstModule;
+extern long imageReallocationCount;
 extern bool isFatalWarnings;
 extern bool isFlexibleSyntax;
 extern bool isImplicitExternals;
+extern bool isObjectStreamed;
+extern bool isRelocationCompacted;
 extern bool isSectionStackingEnabled;
+extern bool isTimeReferenced;
 extern Module *lastModule;
+extern Arena lineArena;
 extern u16 listControlMask;
 extern u16 listControlStack[];
 extern int listControlStackPtr;
@@ -68,7 +76,12 @@ extern char *locationField;
 extern Token *locationFieldToken;
 extern MacroCall *macroStack[];
 extern int macroStackPtr;
+extern long microReferenceCount;
+extern Arena moduleArena;
 extern Name *moduleNames;
+extern char *objectCacheDir;
+extern long objectCacheHits;
+extern long objectCacheMisses;
 extern Dataset *objectFile;
 extern char *operandField;
 extern char *osDate;
@@ -76,9 +89,12 @@ extern char *osName;
 extern int pass;
 extern Qualifier *qualifierStack[];
 extern int qualifierStackPtr;
+extern long relocationEntriesRemoved;
 extern char *resultField;
 extern Section *sectionStack[];
 extern int sectionStackPtr;
+extern char *sourceBuffer;
+extern int sourceBufferLength;
 extern FILE *sourceFile;
 extern char sourceFilePath[];
 extern SourceFormatType sourceFormatStack[];
@@ -92,16 +108,22 @@ void addEntryPoint(Module *module, Symbol *symbol);
 void addExternal(Module *module, Symbol *symbol);
 Literal *addLiteral(Token *expression);
 ErrorCode addLocationSymbol(Section *section, char *id, int len, u16 attributes);
+Name *addMicro(Module *module, char *id, int len);
 Module *addModule(char *id, int len);
 Name *addName(Name **root, char *id, int len);
+void addObjectCacheText(void);
 Qualifier *addQualifier(char *id, int len);
 Section *addSection(Module *module, char *id, int len, SectionType type, SectionLocation location);
 Symbol *addSymbol(char *id, int len, Qualifier *qualifier, Value *value);
 void adjustSymbolValues(Module *module);
 void advanceBitPosition(Section *section, int count);
+void *arenaAllocate(Arena *arena, int size);
+void arenaReset(Arena *arena);
+void assembleJob(int argc, char *argv[], char *jobTextPath, int textCount);
+int  assembleJobText(int argc, char *argv[], char *jobTextPath);
 ErrorCode callMacro(MacroDefn *defn, Token *locationFieldToken);
 void clearErrorIndications(void);
-Token *copyToken(Token *token);
+Token *copyToken(Token *token, Arena *arena);
 void createObjectBlocks(Module *module);
 void emit_g_h_i_jkm(Section *section, u8 g, u8 h, u8 i, Value *jkm);
 void emit_gh_i_j_k(Section *section, u8 gh, u8 i, u8 j, u8 k);
@@ -114,10 +136,13 @@ void emitFieldEnd(Section *section);
 void emitFieldStart(Section *section);
 void emitLiterals(Module *module);
 void emitString(Section *section, char *s, int len, int count, JustifyType justification);
+void endPhase(StatsPhase phase);
 bool equalTokens(Token *t1, Token *t2);
 ErrorCode evaluateExpression(Token *expression, Value *value);
 NamedInstruction *findInstruction(char *id, int len);
+Name *findMicro(Module *module, char *id, int len);
 Module *findModule(char *id, int len);
+Section *findSection(Module *module, char *id, int len);
 Name *findName(Name *root, char *id, int len);
 Symbol *findQualifiedSymbol(Token *token);
 Qualifier *findQualifier(char *id);
@@ -125,7 +150,7 @@ Qualifier *findQualifierWithLen(char *id, int len);
 Symbol *findSymbol(char *id, int len, Qualifier *qualifier);
 void forceWordBoundary(Section *section);
 void freeMacroCall(MacroCall *call);
-void freeToken(Token *token);
+void freeMacroDefn(MacroDefn *defn);
 ErrorCode getErrorCode(char *s, int len);
 int getErrorCount(void);
 char *getErrorIndications(void);
@@ -135,11 +160,15 @@ char *getNextToken(char *s, Token *token);
 char *getNextValue(char *s, Value *value, ErrorCode *err);
 ErrorCode getRegisterNumber(Token *regster, int *number);
 u16 getRelativeAttribute(Section *section);
+int getSourceLineIndex(void);
 u16 getValueType(Value *value);
 int getWarningCount(void);
 int handleExp(void);
 bool hasErrorRegistrations(void);
+u32 hashId(char *id, int len);
+u32 hashToken(Token *token);
 void instInit(void);
+void invalidateTextCache(void);
 bool isAbsolute(Value *value);
 bool isByteAddress(Value *value);
 bool isCodeSection(Section *section);
@@ -149,6 +178,7 @@ bool isDefined(Value *value);
 int isEof(void);
 bool isExternal(Value *value);
 bool isImmobile(Value *value);
+bool isJobTextCurrent(int argc, char *argv[], char *jobTextPath);
 bool isNameChar(char c);
 bool isNameChar1(char c);
 bool isNamedCommonSection(Section *section);
@@ -162,6 +192,7 @@ bool isRelocatable(Value *value);
 bool isSameSection(Section *s1, Section *s2);
 bool isUnqualifiedName(Token *token);
 bool isWordAddress(Value *value);
+void listCapture(FILE *fp);
 void listClearSource(void);
 void listCode(u64 bits, int count, int lastCol);
 void listCode16(u16 bits);
@@ -174,22 +205,41 @@ void listErrorSummary(void);
 void listField(u64 bits, int len, u16 attributes, int colOffset);
 void listFlush(Section *section);
 void listInit(void);
+void listJournal(bool isEnabled);
+int  listLineNumber(void);
 void listLocation(u32 location);
+void listMerge(FILE *from, FILE *to, int startLineNumber, int endLineNumber, bool isRestamped);
+int  listRender(FILE *from, FILE *to);
 void listSource(void);
 void listSymbolTable(void);
 void listValue(Value *val);
 void listWord(u64 bits, u16 attributes);
+void loadSource(void);
+bool loadObjectCache(char *ident);
+bool loadTextCache(void);
+void mergeStats(AssemblyStats *stats);
 char *parseExpression(char *s, Token **expression);
 ErrorCode parseSourceLine(void);
 void printStackTrace(FILE *file);
 void printToken(FILE *file, Token *token);
 ErrorCode processMachineInstruction(void);
 void readNextLine(void);
+void recordTreeDepths(void);
+void releaseFieldCache(void);
+void releaseObjectSpills(void);
 ErrorCode registerError(ErrorCode code);
 void reserveStorage(Section *section, u32 firstAddress, u32 count);
 void resetBase(void);
 void resetModule(Module *module);
 void resetErrorRegistrations(void);
+void reportStats(FILE *fp);
+void reportStatsJSON(FILE *fp);
+void requestJob(char *path, char *jobTextPath, int argc, char *argv[]);
+void rewindSource(void);
+void saveObjectCache(void);
+void saveTextCache(void);
+void serveJobs(char *path);
+void startPhase(StatsPhase phase);
 u64 toCrayFloat(u64 ieee);
 int writeObjectRecord(Module *module, Dataset *ds);
 
@@ -25,6 +25,46 @@
 */
 
 #include "basetypes.h"
+#include "cosdataset.h"
+
+/*
+ *  Arenas
+ */
+typedef struct arenaBlock {
+    struct arenaBlock *next;
+    u8 *data;
+    int size;
+    int used;
+} ArenaBlock;
+
+typedef struct arena {
+    ArenaBlock *first;
+    ArenaBlock *current;
+    int blockCount;
+} Arena;
+
+/*
+ *  Compiled regular expressions
+ */
+typedef enum reOpType {
+    ReOpType_Class = 0,
+    ReOpType_CloseCapture,
+    ReOpType_Error,
+    ReOpType_OpenCapture,
+    ReOpType_SkipTo
+} ReOpType;
+
+typedef struct reOp {
+    ReOpType type;
+    bool isAny;
+    bool hasZeroOrMore;
+    u8 members[32];
+} ReOp;
+
+typedef struct compiledRE {
+    int count;
+    ReOp ops[1];
+} CompiledRE;
 
 /*
  *  Error indications
@@ -105,6 +145,7 @@ typedef struct macroParam {
     MacroParamType type;
     char *name;
     char *value;
+    int index;
 } MacroParam;
 
 typedef enum macroFragType {
@@ -117,6 +158,8 @@ typedef struct macroFragment {
     struct macroFragment *next;
     MacroFragType type;
     char *text;
+    int paramIndex;
+    struct compiledRE *program;
 } MacroFragment;
 
 typedef struct macroLine {
@@ -128,12 +171,18 @@ typedef struct macroDefn {
     int creationPass;
     MacroParam *locationParam;
     MacroParam *params;
+    int paramCount;
     MacroLine *body;
 } MacroDefn;
 
+/*
+ *  The values of a macro call are indexed like the parameters of its
+ *  definition: the location parameter is 0, and the others are numbered
+ *  from 1 in order of definition.
+ */
 typedef struct macroCall {
     MacroDefn *defn;
-    MacroParam *params;
+    char **values;
     MacroLine *nextLine;
 } MacroCall;
 
@@ -145,6 +194,7 @@ typedef struct macroCall {
 typedef struct name {
     struct name *left;
     struct name *right;
+    struct name *nextInChain;
     char *id;
     void *value;
 } Name;
@@ -188,8 +238,8 @@ typedef struct value {
 } Value;
 
 typedef struct symbol {
-    struct symbol *left;
-    struct symbol *right;
+    struct symbol *nextInChain;
+    struct symbol *nextInQualifier;
     struct symbol *next;
     char *id;
     u16 externalIndex;
@@ -200,7 +250,11 @@ typedef struct qualifier {
     struct qualifier *left;
     struct qualifier *right;
     char *id;
-    Symbol *symbols;
+    Symbol **symbolIndex;
+    u32 symbolIndexSize;
+    u32 symbolCount;
+    Symbol *firstSymbol;
+    Symbol *lastSymbol;
 } Qualifier;
 
 /*
@@ -251,6 +305,7 @@ typedef struct objectBlock {
     SectionType type;
     SectionLocation location;
     u8 *image;
+    u32 imageBase;      // byte offset in the block of image[0], if object code is streamed
     u32 imageSize;
     u32 offset;
     int isNotEmpty;
@@ -266,7 +321,12 @@ typedef struct objectBlock {
 
 typedef struct section {
     struct section *next;
+    struct section *nextInChain;    // next section with a different id in the same hash chain
+    struct section *nextSameId;     // next section with the same id
+    struct section *nextRelocated;  // next section in the relocation terms of an expression
     char *id;
+    int index;
+    bool isRelocated;
     struct module *module;
     SectionType type;
     SectionLocation location;
@@ -287,8 +347,7 @@ typedef struct section {
 #define INST_MACHINE 0x01
 
 typedef struct namedInstruction {
-    struct namedInstruction *left;
-    struct namedInstruction *right;
+    struct namedInstruction *next;
     char *id;
     u8 attributes;
     ErrorCode (*handler)(void);
@@ -456,7 +515,9 @@ typedef struct token {
 
 typedef struct literal {
     struct literal *next;
+    struct literal *nextInChain;
     Token *expression;
+    u32 hash;
     u32 offset;
 } Literal;
 
@@ -468,16 +529,57 @@ typedef struct module {
     u32  stackSize;
     Name *duplicateds;
     Name *macros;
-    Name *micros;
+    Name **microIndex;
+    u32 microIndexSize;
+    u32 microCount;
     Qualifier *qualifiers;
     Literal *literals;
+    Literal *lastLiteral;
+    Literal **literalIndex;
+    u32 literalIndexSize;
+    u32 literalCount;
     Symbol *start;
     Symbol *entryPoints;
     Symbol *externals;
     Section *firstSection;
     Section *lastSection;
+    Section **sectionIndex;
+    u32 sectionIndexSize;
+    u32 sectionCount;
     ObjectBlock *firstObjectBlock;
     ObjectBlock *lastObjectBlock;
+    Dataset *objectSpill;
+    char *objectSpillPath;
 } Module;
 
+/*
+ *  Assembly statistics
+ */
+typedef enum statsPhase {
+    StatsPhase_Pass1 = 0,
+    StatsPhase_Literals,
+    StatsPhase_ObjectBlocks,
+    StatsPhase_Pass2,
+    StatsPhase_Listing,
+    StatsPhase_ObjectCode,
+    StatsPhase_Count
+} StatsPhase;
+
+typedef struct phaseTime {
+    double wall;
+    double cpu;
+} PhaseTime;
+
+typedef struct assemblyStats {
+    PhaseTime phases[StatsPhase_Count];
+    long linesRead;
+    long macroLinesGenerated;
+    long symbolsCreated;
+    long qualifiersCreated;
+    long literalsCreated;
+    long objectBytesWritten;
+    int macroTreeDepth;
+    int qualifierTreeDepth;
+} AssemblyStats;
+
 #endif
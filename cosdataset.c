@@ -28,6 +28,9 @@
 #include <string.h>
 #include <unistd.h>
 #include "cosdataset.h"
+#if !defined(__cos)
+#include <sys/stat.h>
+#endif
 
 #ifdef __cos
 
@@ -60,6 +63,10 @@ bool cosDsIsEOR(u64 cw) {
     return cw == COS_EOR;
 }
 
+long cosDsLastFilePosition(Dataset *ds) {
+    return -1;
+}
+
 Dataset *cosDsOpen(char *pathname) {
     Dataset *ds;
     int fd;
@@ -86,6 +93,14 @@ int cosDsRewind(Dataset *ds) {
     return _reopen(ds->fd);
 }
 
+int cosDsSeek(Dataset *ds, long position) {
+    return -1;
+}
+
+long cosDsTell(Dataset *ds) {
+    return -1;
+}
+
 int cosDsWrite(Dataset *ds, u8 *buffer, int len) {
     return write(ds->fd, buffer, len);
 }
@@ -110,6 +125,7 @@ int cosDsWriteWord(Dataset *ds, u64 word) {
 
 static int appendCW(Dataset *ds, u64 cw);
 static int flushBuffer(Dataset *ds);
+static u64 getBufferWord(u8 *buffer, int index);
 static u64 getWord(Dataset *ds);
 static void setFWI(Dataset *ds);
 
@@ -141,20 +157,53 @@ int cosDsClose(Dataset *ds) {
     return 0;
 }
 
+/*
+ *  cosDsCopyRecords - copy the records preceding the next EOF or EOD of one
+ *  dataset to another
+ */
+int cosDsCopyRecords(Dataset *from, Dataset *to) {
+    u8 buf[COS_BLOCK_SIZE];
+    u64 cw;
+    int n;
+
+    while (1) {
+        n = cosDsRead(from, buf, sizeof(buf));
+        if (n < 0) return -1;
+        if (n > 0 && cosDsWrite(to, buf, n) == -1) return -1;
+        if (from->isAtCW == 0) {
+            if (n == 0) return 0;
+            continue;
+        }
+        cw = cosDsReadCW(from);
+        if (cosDsIsEOR(cw) == 0) return 0;
+        if (cosDsWriteEOR(to) == -1) return -1;
+    }
+}
+
 /*
  *  cosDsCreate - create a dataset
  */
 Dataset *cosDsCreate(char *pathname) {
     Dataset *ds;
+    int fd;
+
+    fd = open(pathname, O_CREAT|O_WRONLY|O_TRUNC, 0644);
+    if (fd == -1) return NULL;
+    ds = cosDsCreateFd(fd);
+    if (ds == NULL) close(fd);
+    return ds;
+}
+
+/*
+ *  cosDsCreateFd - create a dataset on an open file descriptor
+ */
+Dataset *cosDsCreateFd(int fd) {
+    Dataset *ds;
 
     ds = (Dataset *)malloc(sizeof(Dataset));
     if (ds == NULL) return NULL;
     memset(ds, 0, sizeof(Dataset));
-    ds->fd = open(pathname, O_CREAT|O_WRONLY|O_TRUNC, 0644);
-    if (ds->fd == -1) {
-        free(ds);
-        return NULL;
-    }
+    ds->fd = fd;
     ds->cursor = 8;
     ds->isWritable = 1;
     return ds;
@@ -188,6 +237,52 @@ bool cosDsIsEOR(u64 cw) {
     return (cw >> 60) == COS_CW_EOR;
 }
 
+/*
+ *  cosDsLastFilePosition - find the position of the first word of the last
+ *                          file of a dataset
+ *
+ *  The previous file index of the EOF ending the last file identifies the
+ *  block containing the EOF that precedes it, so only the final two blocks
+ *  of the dataset and that block are read. The position of the dataset is
+ *  not changed. Returns 0 if the dataset contains only one file.
+ */
+long cosDsLastFilePosition(Dataset *ds) {
+    int block;
+    u8 buf[COS_BLOCK_SIZE * 2];
+    u64 cw;
+    long eofPosition;
+    int firstBlock;
+    int index;
+    int n;
+    long position;
+    struct stat st;
+
+    if (ds == NULL || ds->isWritable) return -1;
+    if (fstat(ds->fd, &st) == -1 || st.st_size < 8) return -1;
+    firstBlock = (st.st_size - 1) / COS_BLOCK_SIZE;
+    if (firstBlock > 0) firstBlock -= 1;
+    n = pread(ds->fd, buf, sizeof(buf), (off_t)firstBlock * COS_BLOCK_SIZE);
+    eofPosition = -1;
+    block = 0;
+    for (index = 0; index + 8 <= n; index += ((cw & COS_BCW_FWI_MASK) + 1) * 8) {
+        cw = getBufferWord(buf, index);
+        if (cosDsIsEOD(cw)) break;
+        if (cosDsIsEOF(cw)) {
+            eofPosition = (long)firstBlock * COS_BLOCK_SIZE + index;
+            block = firstBlock + (index / COS_BLOCK_SIZE) - (int)((cw & COS_RCW_PFI_MASK) >> 24);
+        }
+    }
+    if (eofPosition == -1 || block < 0) return -1;
+    n = pread(ds->fd, buf, COS_BLOCK_SIZE, (off_t)block * COS_BLOCK_SIZE);
+    position = 0;
+    for (index = 0; index + 8 <= n; index += ((cw & COS_BCW_FWI_MASK) + 1) * 8) {
+        if ((long)block * COS_BLOCK_SIZE + index >= eofPosition) break;
+        cw = getBufferWord(buf, index);
+        if (cosDsIsEOF(cw)) position = (long)block * COS_BLOCK_SIZE + index + 8;
+    }
+    return position;
+}
+
 /*
  *  cosDsOpen - open a dataset
  */
@@ -301,6 +396,52 @@ int cosDsRewind(Dataset *ds) {
     return 0;
 }
 
+/*
+ *  cosDsSeek - position a dataset at a word located by cosDsTell or
+ *              cosDsLastFilePosition
+ */
+int cosDsSeek(Dataset *ds, long position) {
+    long blockPosition;
+    u64 cw;
+    int index;
+    int offset;
+
+    if (ds == NULL || ds->isWritable || position < 0 || (position & 7) != 0) return -1;
+    offset = position % COS_BLOCK_SIZE;
+    blockPosition = position - offset;
+    if (lseek(ds->fd, blockPosition, SEEK_SET) == -1) return -1;
+    ds->limit = read(ds->fd, ds->buffer, COS_BLOCK_SIZE);
+    if (ds->limit < 8 || offset > ds->limit) return -1;
+    //
+    //  Follow the control words from the BCW to the first one at or beyond
+    //  the position.
+    //
+    index = 0;
+    while (index < offset) {
+        cw = getBufferWord(ds->buffer, index);
+        index += ((cw & COS_BCW_FWI_MASK) + 1) * 8;
+    }
+    ds->cursor = offset;
+    ds->bytesRead = position;
+    ds->nextCtrlWordIndex = blockPosition + index;
+    ds->isAtCW = 0;
+    return 0;
+}
+
+/*
+ *  cosDsTell - return the position of the next word to be read from or
+ *              written to a dataset
+ */
+long cosDsTell(Dataset *ds) {
+    int cursor;
+
+    if (ds == NULL) return -1;
+    if (ds->isWritable == 0) return ds->bytesRead;
+    cursor = (ds->cursor + 7) & ~7;
+    if (cursor >= COS_BLOCK_SIZE) return (long)(ds->currentBlock + 1) * COS_BLOCK_SIZE + 8;
+    return (long)ds->currentBlock * COS_BLOCK_SIZE + cursor;
+}
+
 /*
  *  cosDsWrite - write a sequence of bytes to a dataset
  */
@@ -352,7 +493,7 @@ int cosDsWriteEOF(Dataset *ds) {
 
     if (ds->cursor >= COS_BLOCK_SIZE && flushBuffer(ds) == -1) return -1;
     setFWI(ds);
-    rcw = ((u64)COS_CW_EOF << 60) | ((ds->currentBlock - ds->lastFileBlock) << 24);
+    rcw = ((u64)COS_CW_EOF << 60) | ((u64)(ds->currentBlock - ds->lastFileBlock) << 24);
     if (appendCW(ds, rcw) == -1) return -1;
     ds->lastFileBlock = ds->lastRecordBlock = ds->currentBlock;
     return 0;
@@ -375,8 +516,8 @@ int cosDsWriteEOR(Dataset *ds) {
     setFWI(ds);
     rcw = ((u64)COS_CW_EOR << 60)
         | ((u64)ubc << 50)
-        | ((ds->currentBlock - ds->lastFileBlock) << 24)
-        | ((ds->currentBlock - ds->lastRecordBlock) << 9);
+        | ((u64)(ds->currentBlock - ds->lastFileBlock) << 24)
+        | ((u64)(ds->currentBlock - ds->lastRecordBlock) << 9);
     if (appendCW(ds, rcw) == -1) return -1;
     ds->lastRecordBlock = ds->currentBlock;
     return 0;
@@ -422,16 +563,20 @@ static int flushBuffer(Dataset *ds) {
     return 0;
 }
 
-static u64 getWord(Dataset *ds) {
+static u64 getBufferWord(u8 *buffer, int index) {
     int i;
     u64 word;
 
     for (word = 0, i = 0; i < 8; i++) {
-        word = (word << 8) | ds->buffer[ds->cursor + i];
+        word = (word << 8) | buffer[index + i];
     }
     return word;
 }
 
+static u64 getWord(Dataset *ds) {
+    return getBufferWord(ds->buffer, ds->cursor);
+}
+
 static void setFWI(Dataset *ds) {
     int cwi;
     int fwi;
@@ -98,15 +98,24 @@ typedef struct dataset {
  *  Function prototypes
  */
 int cosDsClose(Dataset *ds);
+#ifndef __cos
+int cosDsCopyRecords(Dataset *from, Dataset *to);
+#endif
 Dataset *cosDsCreate(char *pathname);
+#ifndef __cos
+Dataset *cosDsCreateFd(int fd);
+#endif
 bool cosDsIsBCW(u64 cw);
 bool cosDsIsEOD(u64 cw);
 bool cosDsIsEOF(u64 cw);
 bool cosDsIsEOR(u64 cw);
+long cosDsLastFilePosition(Dataset *ds);
 Dataset *cosDsOpen(char *pathname);
 int cosDsRead(Dataset *ds, u8 *buffer, int len);
 u64 cosDsReadCW(Dataset *ds);
 int cosDsRewind(Dataset *ds);
+int cosDsSeek(Dataset *ds, long position);
+long cosDsTell(Dataset *ds);
 int cosDsWrite(Dataset *ds, u8 *buffer, int len);
 int cosDsWriteEOD(Dataset *ds);
 int cosDsWriteEOF(Dataset *ds);
@@ -0,0 +1,31 @@
+#
+#  blocks.awk - generate a CAL module whose code refers to many common blocks
+#
+#  Usage: awk -v subs=count -v blocks=count -f blocks.awk
+#
+#  The module resembles the code kftc produces for a program of many
+#  subroutines that share the same common blocks. Each subroutine SUBk
+#  performs, for every common block Cj, the equivalent of the statement
+#  ARRj(9) = ARRj(10) + ARRj+1(9), where ARRj is the array that Cj holds,
+#  so that it makes three references to labels within common blocks.
+#
+BEGIN {
+    printf "%-9s%-10s%s\n", "", "IDENT", "BLOCKS"
+    printf "%-9s%-10s%s\n", "", "START", "SUB0"
+    for (k = 0; k < subs; k++) {
+        printf "%-9s%-10s%s\n", sprintf("SUB%d", k), "BSS", "0"
+        for (j = 0; j < blocks; j++) {
+            printf "%-9s%-10sARR%d+9,\n", "", "S1", j
+            printf "%-9s%-10sARR%d+8,\n", "", "S2", (j + 1) % blocks
+            printf "%-9s%-10s%s\n", "", "S1", "S1+FS2"
+            printf "%-9s%-10s%s\n", "", sprintf("ARR%d+8,", j), "S1"
+        }
+        printf "%-9s%-10s%s\n", "", "J", "B00"
+    }
+    for (j = 0; j < blocks; j++) {
+        printf "%-9s%-10s%s\n", sprintf("C%d", j), "SECTION", "COMMON"
+        printf "%-9s%-10s%d\n", sprintf("ARR%d", j), "BSS", 10
+        printf "%-9s%s\n", "", "SECTION   *"
+    }
+    printf "%-9s%s\n", "", "END"
+}
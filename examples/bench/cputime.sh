@@ -0,0 +1,29 @@
+#!/bin/sh
+#
+#  cputime.sh - report the average CPU time taken by a command
+#
+#  Usage: cputime.sh runs command [arg ...]
+#
+#  The command is run the given number of times with its output discarded,
+#  and the average user plus system time of a run is printed in seconds.
+#  The exit status of the command is ignored.
+#
+runs=$1
+shift
+i=0
+while [ $i -lt $runs ]
+do
+    "$@" >/dev/null 2>&1
+    i=`expr $i + 1`
+done
+tmp=`mktemp`
+times >$tmp
+awk -v runs=$runs 'NR == 2 {
+    t = 0
+    for (i = 1; i <= 2; i++) {
+        split($i, f, "m")
+        t += f[1] * 60 + f[2]
+    }
+    printf "%.4f\n", t / runs
+}' $tmp
+rm -f $tmp
@@ -0,0 +1,17 @@
+#
+#  labels.awk - generate a CAL module that defines and references many labels
+#
+#  Usage: awk -v n=count -f labels.awk
+#
+#  Labels are defined in sorted order, each by a CON, and then each is
+#  referenced once, in an order that visits the labels in a scattered
+#  sequence. Every label is looked up twice in each pass, once where it
+#  is defined and once where it is referenced. The count must not be a
+#  multiple of 7919.
+#
+BEGIN {
+    printf "%-9s%-10s%s\n", "", "IDENT", "LABELS"
+    for (i = 0; i < n; i++) printf "L%07d  %-10s%d\n", i, "CON", i
+    for (i = 0; i < n; i++) printf "%-9s%-10sL%07d\n", "", "CON", (i * 7919) % n
+    printf "%-9s%s\n", "", "END"
+}
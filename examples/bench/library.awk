@@ -0,0 +1,33 @@
+#
+#  library.awk - generate the modules of a library and a main program that
+#                refers to many of their entry points
+#
+#  Usage: awk -v n=modules -v refs=count -f library.awk
+#
+#  Module k is written to library/Mk.cal. It declares the eight entry
+#  points EkX0 through EkX7 and refers to one entry point of each of
+#  modules k+1 and k+7, so that loading any module draws in the rest of
+#  the library. The main program is written to main.cal and refers to
+#  refs entry points scattered through the library. The number of modules
+#  must not be a multiple of 7919, and refs must not exceed it.
+#
+BEGIN {
+    for (k = 0; k < n; k++) {
+        path = sprintf("library/M%d.cal", k)
+        printf "%-9s%-10sM%d\n", "", "IDENT", k > path
+        printf "%-9s%-10sE%dX0,E%dX1,E%dX2,E%dX3\n", "", "ENTRY", k, k, k, k > path
+        printf "%-9s%-10sE%dX4,E%dX5,E%dX6,E%dX7\n", "", "ENTRY", k, k, k, k > path
+        printf "%-9s%-10sE%dX%d,E%dX%d\n", "", "EXT", (k + 1) % n, k % 8, (k + 7) % n, (k * 3) % 8 > path
+        for (i = 0; i < 8; i++) printf "%-9s%-10s%d\n", sprintf("E%dX%d", k, i), "S1", i > path
+        printf "%-9s%-10sE%dX%d\n", "", "CON", (k + 1) % n, k % 8 > path
+        printf "%-9s%-10sE%dX%d\n", "", "CON", (k + 7) % n, (k * 3) % 8 > path
+        printf "%-9s%s\n", "", "END" > path
+        close(path)
+    }
+    printf "%-9s%-10s%s\n", "", "IDENT", "MAIN" > "main.cal"
+    printf "%-9s%-10s%s\n", "", "START", "MAIN" > "main.cal"
+    for (i = 0; i < refs; i++) printf "%-9s%-10sE%dX%d\n", "", "EXT", (i * 7919) % n, i % 8 > "main.cal"
+    printf "%-9s%-10s%d\n", "MAIN", "S1", 1 > "main.cal"
+    for (i = 0; i < refs; i++) printf "%-9s%-10sE%dX%d\n", "", "CON", (i * 7919) % n, i % 8 > "main.cal"
+    printf "%-9s%s\n", "", "END" > "main.cal"
+}
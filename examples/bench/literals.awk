@@ -0,0 +1,43 @@
+#
+#  literals.awk - generate a CAL module that uses many distinct literals
+#
+#  Usage: awk -v n=count -f literals.awk
+#
+#  The module uses the integer literals 1 through n, with further distinct
+#  floating point, character and symbol literals among them. Most literals
+#  are used again later, spelled in a different way that denotes the same
+#  literal: an integer in octal, a floating point value with a trailing
+#  zero, or a symbol in lower case. Character strings are used again with
+#  the same spelling, and each upper case string has a lower case partner
+#  that is a distinct literal, because case is significant in strings. The
+#  first line of the module is a comment that records the number of
+#  distinct literals, which is the number of literals the assembler should
+#  create.
+#
+BEGIN {
+    printf "* LITERALS %d\n", n + int(n / 11) + 2 * int(n / 13) + int(n / 17)
+    printf "%-9s%-10s%s\n", "", "IDENT", "LITERALS"
+    for (i = 1; i <= n; i++) {
+        printf "%-9s%-10s=%d\n", "", "S1", i
+        if (i % 5 == 0) printf "%-9s%-10s=O'%o\n", "", "S2", i / 5
+        if (i % 7 == 0) printf "%-9s%-10s=%d\n", "", "S2", i / 7
+        if (i % 11 == 0) {
+            k = i / 11
+            printf "%-9s%-10s=%d.5\n", "", "S3", k
+            if (k > 1) printf "%-9s%-10s=%d.50\n", "", "S3", int(k / 2)
+        }
+        if (i % 13 == 0) {
+            k = i / 13
+            printf "%-9s%-10s='AB%d'L\n", "", "S4", k
+            printf "%-9s%-10s='ab%d'L\n", "", "S4", k
+            if (k > 1) printf "%-9s%-10s='AB%d'L\n", "", "S4", int(k / 2)
+        }
+        if (i % 17 == 0) {
+            k = i / 17
+            printf "N%-8d%-10s%d\n", k, "=", i
+            printf "%-9s%-10s=N%d\n", "", "S5", k
+            if (k > 1) printf "%-9s%-10s=n%d\n", "", "S5", int(k / 2)
+        }
+    }
+    printf "%-9s%s\n", "", "END"
+}
@@ -0,0 +1,37 @@
+#
+#  relocations.awk - generate a CAL module that has many relocatable fields
+#
+#  Usage: awk -v n=count -f relocations.awk
+#
+#  For each of n labels, the module written to relocations.cal has parcel
+#  and word address fields of 22, 24, and 32 bits that refer to the label,
+#  and fields that refer to the external symbols XE1 and XE2, which are
+#  defined by the module written to externals.cal.
+#
+BEGIN {
+    path = "relocations.cal"
+    printf "%-9s%-10s%s\n", "", "IDENT", "RELOCS" > path
+    printf "%-9s%-10s%s\n", "", "ENTRY", "RELOCS" > path
+    printf "%-9s%-10s%s\n", "", "EXT", "XE1,XE2" > path
+    printf "%-9s%-10s%s\n", "", "START", "RELOCS" > path
+    printf "%-9s%-10s%s\n", "RELOCS", "=", "*" > path
+    for (i = 0; i < n; i++) {
+        printf "%-9s%-10sL%d\n", sprintf("L%d", i), "S1", i > path
+        printf "%-9s%-10sL%d\n", "", "J", (i * 7) % n > path
+        printf "%-9s%-10sXE%d\n", "", "R", 1 + i % 2 > path
+        printf "%-9s%-10sL%d\n", "", "CON", i > path
+        printf "%-9s%-10sXE%d\n", "", "CON", 1 + i % 2 > path
+        printf "%-9s%-10s40/0,24/L%d\n", "", "VWD", i > path
+        printf "%-9s%-10s16/0,32/XE1\n", "", "VWD" > path
+    }
+    printf "%-9s%s\n", "", "END" > path
+    close(path)
+    path = "externals.cal"
+    printf "%-9s%-10s%s\n", "", "IDENT", "EXTERNS" > path
+    printf "%-9s%-10s%s\n", "", "ENTRY", "XE1,XE2" > path
+    printf "%-9s%-10s%s\n", "XE1", "=", "*" > path
+    printf "%-9s%-10s%d\n", "", "CON", 0 > path
+    printf "%-9s%-10s%s\n", "XE2", "CON", "XE1" > path
+    printf "%-9s%s\n", "", "END" > path
+    close(path)
+}
@@ -0,0 +1,300 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright 2021 Kevin E. Jordan
+**
+**  Name: relocbench.c
+**
+**  Description:
+**      This file times the relocation of fields in the load image of ldr.
+**      It applies the same relocations to an image of bytes, using the
+**      routines by which ldr relocated fields before its image was held as
+**      words, and to the word image of ldr, using relocateField, checks
+**      that both produce the same image, and reports the time taken by
+**      each per relocation.
+**
+**  Licensed under the Apache License, Version 2.0 (the "License");
+**  you may not use this file except in compliance with the License.
+**  You may obtain a copy of the License at
+**
+**      http://www.apache.org/licenses/LICENSE-2.0
+**
+**  Unless required by applicable law or agreed to in writing, software
+**  distributed under the License is distributed on an "AS IS" BASIS,
+**  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**  See the License for the specific language governing permissions and
+**  limitations under the License.
+**
+**--------------------------------------------------------------------------
+*/
+
+#define main ldrMain
+#include "../../ldr.c"
+#undef main
+
+#include <time.h>
+
+#define IMAGE_WORDS      (1 << 16)
+#define RELOCATION_COUNT 4000000
+#define ROUNDS           3
+
+typedef enum {
+    FieldKind_Standard = 0,
+    FieldKind_Parcel24,
+    FieldKind_Word,
+    FieldKind_Any22,
+    FieldKind_Mixed,
+    FieldKindCount
+} FieldKind;
+
+typedef struct relocation {
+    bool isStandard;
+    u32  rightmostBit;
+    u16  fieldLength;
+    u64  increment;
+} Relocation;
+
+static u64 byteGetField(u8 *bytes, u32 rightmostBit, u16 fieldLength);
+static void bytePutField(u8 *bytes, u32 rightmostBit, u16 fieldLength, u64 field);
+static void byteRelocateStandard(u8 *bytes, u32 parcelAddress, u64 increment);
+static int compareRelocations(const void *r1, const void *r2);
+static u64 formMask(int len);
+static void generateRelocations(Relocation *relocations, FieldKind kind);
+static void timeRelocations(Relocation *relocations, FieldKind kind);
+
+static u8 *byteImage;
+static char *kindNames[FieldKindCount] = {
+    "standard BRT, 32-bit parcel field",
+    "24-bit parcel field (XRT/extended)",
+    "64-bit word field",
+    "22-bit field at any bit position",
+    "random mix of the above"
+};
+
+int main(int argc, char *argv[]) {
+    FieldKind kind;
+    Relocation *relocations;
+
+    byteImage = (u8 *)allocate(IMAGE_WORDS * 8);
+    image = (u64 *)allocate(IMAGE_WORDS * sizeof(u64));
+    relocations = (Relocation *)allocate(RELOCATION_COUNT * sizeof(Relocation));
+    printf("%d relocations applied in address order to a %d word image (ns per relocation)\n",
+           RELOCATION_COUNT, IMAGE_WORDS);
+    printf("  %-36s %6s %6s\n", "field", "bytes", "words");
+    for (kind = FieldKind_Standard; kind < FieldKindCount; kind++) {
+        generateRelocations(relocations, kind);
+        timeRelocations(relocations, kind);
+    }
+    free(relocations);
+    free(image);
+    free(byteImage);
+
+    exit(0);
+}
+
+/*
+ *  byteGetField, bytePutField - get and put a field of an image of bytes,
+ *                               as ldr did before its image was held as words
+ */
+static u64 byteGetField(u8 *bytes, u32 rightmostBit, u16 fieldLength) {
+    u32 byteOffset;
+    u64 field;
+    u64 mask;
+    int shiftCount;
+
+    byteOffset = (rightmostBit >> 3) - 7;
+    mask = formMask(fieldLength);
+    if ((rightmostBit & 7) == 7) { /* byte-aligned */
+        field = getWord(bytes + byteOffset);
+    }
+    else {
+        field = getWord(bytes + byteOffset);
+        shiftCount = 7 - (rightmostBit & 7);
+        field >>= shiftCount;
+        if (fieldLength >= 56) {
+            field = field | ((u64)bytes[byteOffset - 1] << (64 - shiftCount));
+        }
+    }
+    return field & mask;
+}
+
+static void bytePutField(u8 *bytes, u32 rightmostBit, u16 fieldLength, u64 field) {
+    u32 byteOffset;
+    u64 mask;
+    int shiftCount;
+    u64 word;
+
+    mask = formMask(fieldLength);
+    field &= mask;
+    byteOffset = (rightmostBit >> 3) - 7;
+    if ((rightmostBit & 7) == 7) { /* byte-aligned */
+        word = (getWord(bytes + byteOffset) & ~mask) | field;
+        putWord(bytes + byteOffset, word);
+    }
+    else {
+        shiftCount = 7 - (rightmostBit & 7);
+        word = (getWord(bytes + byteOffset) & ~(mask << shiftCount)) | (field << shiftCount);
+        putWord(bytes + byteOffset, word);
+        if (fieldLength >= 56) {
+            byteOffset -= 1;
+            mask = formMask(shiftCount);
+            bytes[byteOffset] = (bytes[byteOffset] & ~mask) | (field >> (64 - shiftCount));
+        }
+    }
+}
+
+/*
+ *  byteRelocateStandard - relocate the 32 bit field starting at a parcel of
+ *                         an image of bytes, as ldr did for standard BRT
+ *                         entries
+ */
+static void byteRelocateStandard(u8 *bytes, u32 parcelAddress, u64 increment) {
+    u32 imageBytes;
+    int imageOffset;
+
+    imageOffset = parcelAddress * 2;
+    imageBytes = (bytes[imageOffset  ] << 24)
+               | (bytes[imageOffset+1] << 16)
+               | (bytes[imageOffset+2] <<  8)
+               |  bytes[imageOffset+3];
+    imageBytes += increment;
+    bytes[imageOffset  ] =  imageBytes >> 24;
+    bytes[imageOffset+1] = (imageBytes >> 16) & 0xff;
+    bytes[imageOffset+2] = (imageBytes >>  8) & 0xff;
+    bytes[imageOffset+3] =  imageBytes        & 0xff;
+}
+
+static int compareRelocations(const void *r1, const void *r2) {
+    u32 bit1;
+    u32 bit2;
+
+    bit1 = ((Relocation *)r1)->rightmostBit;
+    bit2 = ((Relocation *)r2)->rightmostBit;
+    return (bit1 < bit2) ? -1 : (bit1 > bit2) ? 1 : 0;
+}
+
+/*
+ *  formMask - form the mask of a field of a given length, as ldr did
+ */
+static u64 formMask(int len) {
+    u64 mask;
+
+    switch (len) {
+    case 8:
+        mask = 0xff;
+        break;
+    case 16:
+        mask = 0xffff;
+        break;
+    case 22:
+        mask = 0x3fffff;
+        break;
+    case 24:
+        mask = 0xffffff;
+        break;
+    case 32:
+        mask = 0xffffffff;
+        break;
+    case 64:
+        mask = 0xffffffffffffffff;
+        break;
+    default:
+        mask = 0;
+        while (len-- > 0) {
+            mask = (mask << 1) | 1;
+        }
+        break;
+    }
+
+    return mask;
+}
+
+/*
+ *  generateRelocations - generate relocations of fields of a given kind at
+ *                        random addresses, sorted by address as ldr applies
+ *                        them
+ */
+static void generateRelocations(Relocation *relocations, FieldKind kind) {
+    int i;
+    FieldKind k;
+    Relocation *rp;
+    u32 wordAddress;
+
+    srand(1);
+    for (i = 0; i < RELOCATION_COUNT; i++) {
+        rp = &relocations[i];
+        k = (kind == FieldKind_Mixed) ? rand() % FieldKind_Mixed : kind;
+        wordAddress = 1 + rand() % (IMAGE_WORDS - 2);
+        rp->increment = rand() & 0xffff;
+        rp->isStandard = FALSE;
+        switch (k) {
+        case FieldKind_Standard:
+            rp->isStandard = TRUE;
+            rp->fieldLength = 32;
+            rp->rightmostBit = (wordAddress << 6) + ((rand() % 3) << 4) + 31;
+            break;
+        case FieldKind_Parcel24:
+            rp->fieldLength = 24;
+            rp->rightmostBit = (wordAddress << 6) + ((1 + rand() % 3) << 4) + 15;
+            break;
+        case FieldKind_Word:
+            rp->fieldLength = 64;
+            rp->rightmostBit = (wordAddress << 6) + 63;
+            break;
+        default:
+            rp->fieldLength = 22;
+            rp->rightmostBit = (wordAddress << 6) + rand() % 64;
+            break;
+        }
+    }
+    qsort(relocations, RELOCATION_COUNT, sizeof(Relocation), compareRelocations);
+}
+
+/*
+ *  timeRelocations - apply relocations to both images, check that the images
+ *                    agree, and report the best time per relocation of each
+ *
+ *  Standard entries are relocated with a constant field length, as they are
+ *  by processBRT.
+ */
+static void timeRelocations(Relocation *relocations, FieldKind kind) {
+    double byteTime;
+    int i;
+    int round;
+    Relocation *rp;
+    clock_t start;
+    double t;
+    double wordTime;
+
+    memset(byteImage, 0, IMAGE_WORDS * 8);
+    memset(image, 0, IMAGE_WORDS * sizeof(u64));
+    byteTime = wordTime = -1.0;
+    for (round = 0; round < ROUNDS; round++) {
+        start = clock();
+        for (i = 0, rp = relocations; i < RELOCATION_COUNT; i++, rp++) {
+            if (rp->isStandard)
+                byteRelocateStandard(byteImage, (rp->rightmostBit - 31) >> 4, rp->increment);
+            else
+                bytePutField(byteImage, rp->rightmostBit, rp->fieldLength,
+                             byteGetField(byteImage, rp->rightmostBit, rp->fieldLength) + rp->increment);
+        }
+        t = (double)(clock() - start) / CLOCKS_PER_SEC;
+        if (byteTime < 0.0 || t < byteTime) byteTime = t;
+        start = clock();
+        for (i = 0, rp = relocations; i < RELOCATION_COUNT; i++, rp++) {
+            if (rp->isStandard)
+                relocateField(rp->rightmostBit, 32, rp->increment);
+            else
+                relocateField(rp->rightmostBit, rp->fieldLength, rp->increment);
+        }
+        t = (double)(clock() - start) / CLOCKS_PER_SEC;
+        if (wordTime < 0.0 || t < wordTime) wordTime = t;
+    }
+    for (i = 0; i < IMAGE_WORDS; i++) {
+        if (getWord(byteImage + (i * 8)) != image[i]) {
+            fprintf(stderr, "Images differ at word %d after relocating %s\n", i, kindNames[kind]);
+            exit(1);
+        }
+    }
+    printf("  %-36s %6.1f %6.1f\n", kindNames[kind],
+           byteTime * 1.0e9 / RELOCATION_COUNT, wordTime * 1.0e9 / RELOCATION_COUNT);
+}
@@ -0,0 +1,42 @@
+#
+#  repeat.awk - repeat the body of a CAL source file
+#
+#  Usage: awk -v copies=n -f repeat.awk file.cal
+#
+#  The first copy is the source file itself, less its END statement. Each
+#  further copy omits comments, symbol definitions by =, and the pseudo
+#  instructions that may appear only once in a module, and drops labels
+#  other than those of SET, so that every copy refers to the symbols
+#  defined by the first.
+#
+/^[*]/ {
+    body[n++] = $0
+    next
+}
+{
+    op = (substr($0, 1, 1) == " ") ? $1 : $2
+    if (op == "END") next
+    body[n++] = $0
+}
+END {
+    for (i = 0; i < n; i++) print body[i]
+    for (c = 1; c < copies; c++) {
+        for (i = 0; i < n; i++) {
+            line = body[i]
+            if (line ~ /^[*]/ || line ~ /^[ \t]*$/) continue
+            if (substr(line, 1, 1) == " ") {
+                op = line
+                sub(/^[ \t]+/, "", op)
+                sub(/[ \t].*/, "", op)
+            }
+            else {
+                split(line, f)
+                op = f[2]
+                if (op != "SET") line = sprintf("%-9s%s", "", substr(line, index(line, op)))
+            }
+            if (op ~ /^(=|TITLE|SUBTITLE|IDENT|COMMENT|BASE|EXT|ENTRY|START)$/) continue
+            print line
+        }
+    }
+    printf "%-9s%s\n", "", "END"
+}
@@ -27,6 +27,7 @@
 #include "caltypes.h"
 #include "cosdataset.h"
 
+AssemblyStats assemblyStats;
 int baseStack[BASE_STACK_SIZE];
 int baseStackPtr = 0;
 char *calName = "kCAL";
@@ -49,11 +50,16 @@ int editControlStackPtr = 0;
 u32 errorCount = 0;
 u64 errorUnion = 0;
 Module *firstModule = NULL;
+long imageReallocationCount = 0;
 bool isFatalWarnings = FALSE;
 bool isFlexibleSyntax = FALSE;
 bool isImplicitExternals = FALSE;
+bool isObjectStreamed = FALSE;
+bool isRelocationCompacted = FALSE;
 bool isSectionStackingEnabled = TRUE;
+bool isTimeReferenced = FALSE;
 Module *lastModule = NULL;
+Arena lineArena = { NULL, NULL, 0 };
 u16 listControlMask = LIST_ON;
 u16 listControlStack[LIST_CONTROL_STACK_SIZE];
 int listControlStackPtr = 0;
@@ -64,7 +70,12 @@ Token *locationFieldToken = NULL;
 char *locationField = NULL;
 MacroCall *macroStack[MACRO_STACK_SIZE];
 int macroStackPtr = 0;
+long microReferenceCount = 0;
+Arena moduleArena = { NULL, NULL, 0 };
 Name *moduleNames = NULL;
+char *objectCacheDir = NULL;
+long objectCacheHits = 0;
+long objectCacheMisses = 0;
 Dataset *objectFile = NULL;
 char *operandField = NULL;
 char *osDate = "02/28/89";
@@ -73,9 +84,12 @@ u32 parcelCounter = 0;
 int pass = 1;
 Qualifier *qualifierStack[QUALIFIER_STACK_SIZE];
 int qualifierStackPtr = 0;
+long relocationEntriesRemoved = 0;
 char *resultField = NULL;
 Section *sectionStack[BLOCK_STACK_SIZE];
 int sectionStackPtr = 0;
+char *sourceBuffer = NULL;
+int sourceBufferLength = 0;
 FILE *sourceFile = NULL;
 char sourceFilePath[MAX_FILE_PATH_LENGTH+5];
 SourceFormatType sourceFormatStack[SOURCE_FORMAT_STACK_SIZE];
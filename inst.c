@@ -53,6 +53,7 @@ typedef struct patternNode {
     char *pattern;               // original pattern when type == NodeType_PatternEnd
     struct patternNode *next;    // link to next node in this sequence
     struct patternNode *sibling; // link to next adjacent sequence
+    struct patternIndex *index;  // direct lookup of siblings, present on long sibling lists
     union {
         RegisterType regster;
         OperatorType operator;
@@ -60,21 +61,25 @@ typedef struct patternNode {
     } value;
 } PatternNode;
 
+typedef struct patternIndex {
+    PatternNode *byType[NodeType_Expression + 1];     // first sibling of each node type
+    PatternNode *byRegister[RegisterType_XA + 1];     // register siblings by register type
+} PatternIndex;
+
 static void addInstruction(char *id, u8 attributes, InstructionHandler handler);
-static void addMacroCallParam(MacroCall *call, MacroParam *param, char *value, int valueLen);
 static MacroLine *addMacroLine(MacroDefn *defn);
-static void addMacroLineFragment(MacroLine *line, MacroFragType type, char *text, int len);
+static MacroFragment *addMacroLineFragment(MacroLine *line, MacroFragType type, char *text, int len);
 static void addMacroParam(MacroDefn *defn, MacroParamType type, char *name, int nameLen, char *value, int valueLen);
 static void addPattern(char *s, InstructionHandler handler);
 static NamedInstruction *allocInstruction(char *id, u8 attributes, InstructionHandler handler);
 static int compareStrings(char *s1, int s1Len, char *s2, int s2Len);
 static ErrorCode defineSymbol(u16 attributes);
 static MacroParam *findMacroParam(MacroDefn *defn, char *name, int len);
+static PatternNode *findRegisterNode(PatternNode *node, RegisterType type);
 static SectionLocation findSectionLocation(char *name, int len);
 static SectionType findSectionType(char *name, int len);
+static PatternNode *findTypedNode(PatternNode *node, PatternNodeType type);
 static void forceInstWordBoundary(void);
-static void freeInstruction(NamedInstruction *instruction);
-static void freeMacroDefn(MacroDefn *defn);
 static Token *generateZero(void);
 static char *getDelimitedString(char *s, char **start, int *len);
 static char *getNextName(char *s, char **name, int *len);
@@ -85,6 +90,7 @@ static ErrorCode handleOp_i_j_n(u16 opCode, u8 n);
 static ErrorCode handleOp_i_jk(u16 opCode);
 static ErrorCode handleOp_i_n(u16 opCode, u16 n);
 static ErrorCode handleOp_i_n_k(u16 opCode, u8 n);
+static void indexPatterns(PatternNode *node);
 static bool isEquivNode(PatternNode *node1, PatternNode *node2);
 static bool isFloatFour(Value *val);
 static bool isFloatFourEighths(Value *val);
@@ -109,8 +115,8 @@ static void skipLines(Token *locationFieldToken, int count);
 
 static int instArgc;
 static Token *instArgv[MAX_INST_ARGS];
+static NamedInstruction *instructionIndex[INSTRUCTION_INDEX_SIZE];
 static PatternNode *instructionPatterns = NULL;
-static NamedInstruction *namedInstructions = NULL;
 static Value zeroIntVal = {NumberType_Integer, 0, NULL, NULL, 0, 0};
 
 /*
@@ -251,11 +257,8 @@ static ErrorCode BLOCK(void) {
     else {
         return Err_OperandField;
     }
-    for (section = currentModule->firstSection; section != NULL; section = section->next) {
-        if (strncasecmp(section->id, id, len) == 0
-            && section->id[len] == '\0'
-            && section->type == SectionType_Mixed
-            && section->location == SectionLocation_CM) break;
+    for (section = findSection(currentModule, id, len); section != NULL; section = section->nextSameId) {
+        if (section->type == SectionType_Mixed && section->location == SectionLocation_CM) break;
     }
     if (section == NULL) {
         if (pass == 1) {
@@ -400,9 +403,7 @@ static ErrorCode COMMON(void) {
     else {
         return Err_OperandField;
     }
-    for (section = currentModule->firstSection; section != NULL; section = section->next) {
-        if (strncasecmp(section->id, id, len) == 0 && section->id[len] == '\0') break;
-    }
+    section = findSection(currentModule, id, len);
     if (section == NULL) {
         if (pass == 1) {
             section = addSection(currentModule, id, len, SectionType_Common, SectionLocation_CM);
@@ -521,7 +522,6 @@ static ErrorCode DATA(void) {
             emitFieldEnd(currentSection);
             break;
         }
-        freeToken(expression);
         if (*s == ',') {
             s += 1;
             if (currentSection->wordBitPosCounter == 0) {
@@ -944,7 +944,7 @@ static bool hasAttrREG(Token *expression, ErrorCode *err) {
 }
 static bool hasAttrMIC(Token *expression, ErrorCode *err) {
     return isUnqualifiedName(expression)
-        && findName(currentModule->micros, expression->details.name.ptr, expression->details.name.len) != NULL;
+        && findMicro(currentModule, expression->details.name.ptr, expression->details.name.len) != NULL;
 }
 
 typedef struct attrEvalDefn {
@@ -1009,7 +1009,7 @@ static ErrorCode IFA(void) {
     len = opToken.details.name.len;
     if (len == 3 && strncasecmp(op, "REG", 3) == 0) {
         s = getNextToken(s + 1, &token);
-        exp = copyToken(&token);
+        exp = copyToken(&token, &lineArena);
     }
     else {
         s = parseExpression(s + 1, &exp);
@@ -1020,12 +1020,10 @@ static ErrorCode IFA(void) {
         restoreBase();
         if (err != Err_None) return err;
         if (isSimpleInteger(&count) == FALSE || count.value.intValue < 0) {
-            freeToken(exp);
             return Err_OperandField;
         }
     }
     else if (locationFieldToken == NULL) {
-        freeToken(exp);
         return Err_OperandField;
     }
     err = Err_None;
@@ -1038,7 +1036,6 @@ static ErrorCode IFA(void) {
     else {
         err = Err_OperandField;
     }
-    freeToken(exp);
     if (err != Err_None && err != Err_Undefined) return err;
     if (cond != targetCond) skipLines(locationFieldToken, count.value.intValue);
 
@@ -1431,7 +1428,7 @@ static ErrorCode MACRO(void) {
                 pp = findMacroParam(defn, id, s - id);
                 if (pp != NULL) {
                     addMacroLineFragment(line, MacroFragType_Text, start, id - start);
-                    addMacroLineFragment(line, MacroFragType_ParamRef, id, s - id);
+                    addMacroLineFragment(line, MacroFragType_ParamRef, id, s - id)->paramIndex = pp->index;
                     if (*s == '{') {
                         s += 1;
                         re = s;
@@ -1470,10 +1467,7 @@ static ErrorCode MICRO(void) {
         return Err_LocationField;
 
     err = Err_None;
-    name = findName(currentModule->micros, locationFieldToken->details.name.ptr, locationFieldToken->details.name.len);
-    if (name == NULL) {
-        name = addName(&currentModule->micros, locationFieldToken->details.name.ptr, locationFieldToken->details.name.len);
-    }
+    name = addMicro(currentModule, locationFieldToken->details.name.ptr, locationFieldToken->details.name.len);
     s = operandField;
     if (*s == '\0') {
         if (name->value != NULL) free(name->value);
@@ -1548,7 +1542,7 @@ static ErrorCode MICSIZE(void) {
     s = getNextToken(operandField, &token);
     if (err != Err_None) return err;
     if (isUnqualifiedName(&token) == FALSE || *s != '\0') return Err_OperandField;
-    name = findName(currentModule->micros, token.details.name.ptr, token.details.name.len);
+    name = findMicro(currentModule, token.details.name.ptr, token.details.name.len);
     if (name == NULL) return Err_Undefined;
     symbol = findSymbol(locationFieldToken->details.name.ptr, locationFieldToken->details.name.len, currentQualifier);
     val.type = NumberType_Integer;
@@ -1756,14 +1750,12 @@ static ErrorCode SECTION(void) {
     isCommon = type == SectionType_Common
             || type == SectionType_Dynamic
             || type == SectionType_TaskCom;
-    for (section = currentModule->firstSection; section != NULL; section = section->next) {
-        if (strncasecmp(section->id, id, len) == 0 && section->id[len] == '\0') {
-            if (section->type == type && section->location == location) {
-                break;
-            }
-            else if ((isCommon && len > 0) || type != SectionType_Common || isCommonSection(section)) {
-                return Err_DoubleDefinition;
-            }
+    for (section = findSection(currentModule, id, len); section != NULL; section = section->nextSameId) {
+        if (section->type == type && section->location == location) {
+            break;
+        }
+        else if ((isCommon && len > 0) || type != SectionType_Common || isCommonSection(section)) {
+            return Err_DoubleDefinition;
         }
     }
     if (section == NULL) {
@@ -2070,8 +2062,6 @@ static ErrorCode VWD(void) {
             err = evaluateExpression(expression, &val);
             break;
         }
-        freeToken(expression);
-
         if (err != Err_None) {
             if (pass == 1) {
                 val = zeroIntVal;
@@ -2578,7 +2568,6 @@ static ErrorCode J(void) {
     else {
         err = handleBranch(006);
     }
-    freeToken(expr);
     return err;
 }
 
@@ -4422,64 +4411,19 @@ static ErrorCode X_A0_1__Vj(void) {
 }
 
 /*
-**  addInstruction - add a named instruction definition to the instruction tree
+**  addInstruction - add a named instruction definition to the instruction index
 */
 static void addInstruction(char *id, u8 attributes, InstructionHandler handler) {
-    NamedInstruction *current;
+    int len;
     NamedInstruction *new;
-    int valence;
+    NamedInstruction **slot;
 
+    len = strlen(id);
+    if (findInstruction(id, len) != NULL) return;
     new = allocInstruction(id, attributes, handler);
-    current = namedInstructions;
-    if (current == NULL) {
-        namedInstructions = new;
-        return;
-    }
-
-    while (current != NULL) {
-        valence = strcasecmp(current->id, id);
-        if (valence > 0) {
-            if (current->left != NULL) {
-                current = current->left;
-            }
-            else {
-                current->left = new;
-                break;
-            }
-        }
-        else if (valence < 0) {
-            if (current->right != NULL) {
-                current = current->right;
-            }
-            else {
-                current->right = new;
-                break;
-            }
-        }
-        else {
-            freeInstruction(new);
-            new = NULL;
-            break;
-        }
-    }
-}
-
-/*
- *  addMacroCallParam - add a parameter name and value to a macro call structure
- */
-static void addMacroCallParam(MacroCall *call, MacroParam *param, char *value, int valueLen) {
-    int len;
-    MacroParam *new;
-
-    new = (MacroParam *)allocate(sizeof(MacroParam));
-    new->type = param->type;
-    len = strlen(param->name);
-    new->name = (char *)allocate(len + 1);
-    memcpy(new->name, param->name, len);
-    new->value = (char *)allocate(valueLen + 1);
-    memcpy(new->value, value, valueLen);
-    new->next = call->params;
-    call->params = new;
+    slot = &instructionIndex[hashId(id, len) & (INSTRUCTION_INDEX_SIZE - 1)];
+    new->next = *slot;
+    *slot = new;
 }
 
 /*
@@ -4504,15 +4448,16 @@ static MacroLine *addMacroLine(MacroDefn *defn) {
 /*
  *  addMacroLineFragment - add a fragment to a macro line structure chain
  */
-static void addMacroLineFragment(MacroLine *line, MacroFragType type, char *text, int len) {
+static MacroFragment *addMacroLineFragment(MacroLine *line, MacroFragType type, char *text, int len) {
     MacroFragment *fp;
     MacroFragment *new;
 
-    if (len < 1) return;
+    if (len < 1) return NULL;
     new = (MacroFragment *)allocate(sizeof(MacroFragment));
     new->type = type;
     new->text = (char *)allocate(len + 1);
     memcpy(new->text, text, len);
+    if (type == MacroFragType_Regex) new->program = compileRE(new->text, len);
     if (line->fragments == NULL) {
         line->fragments = new;
     }
@@ -4521,6 +4466,7 @@ static void addMacroLineFragment(MacroLine *line, MacroFragType type, char *text
         while (fp->next != NULL) fp = fp->next;
         fp->next = new;
     }
+    return new;
 }
 
 /*
@@ -4532,6 +4478,7 @@ static void addMacroParam(MacroDefn *defn, MacroParamType type, char *name, int
 
     new = (MacroParam *)allocate(sizeof(MacroParam));
     new->type = type;
+    new->index = ++defn->paramCount;
     new->name = (char *)allocate(nameLen + 1);
     memcpy(new->name, name, nameLen);
     if (value != NULL) {
@@ -4620,31 +4567,42 @@ static NamedInstruction *allocInstruction(char *id, u8 attributes, InstructionHa
 }
 
 ErrorCode callMacro(MacroDefn *defn, Token *locationFieldToken) {
-    ErrorCode err;
     MacroCall *call;
+    char *cp;
+    ErrorCode err;
+    int i;
     char *keyword;
     int keywordLen;
     int len;
+    int *lens;
+    int n;
     MacroParam *pp;
     char *s;
+    int size;
     char *start;
     char *value;
     int valueLen;
+    char **values;
 
+    //
+    //  Values are first recorded as references to the location and operand
+    //  fields, then copied to a single block holding the value array and
+    //  the values themselves. Parameters not given values in the call take
+    //  their default values, or empty ones.
+    //
     err = Err_None;
-    call = (MacroCall *)allocate(sizeof(MacroCall));
-    call->defn = defn;
+    n = defn->paramCount + 1;
+    values = (char **)allocate(n * sizeof(char *));
+    lens = (int *)allocate(n * sizeof(int));
     if (locationFieldToken != NULL) {
         if (defn->locationParam != NULL) {
-            addMacroCallParam(call, defn->locationParam, locationFieldToken->details.name.ptr, locationFieldToken->details.name.len);
+            values[0] = locationFieldToken->details.name.ptr;
+            lens[0] = locationFieldToken->details.name.len;
         }
         else {
             (void)registerError(Warn_IgnoredLocationSymbol);
         }
     }
-    else if (defn->locationParam != NULL) {
-        addMacroCallParam(call, defn->locationParam, "", 0);
-    }
     //
     //  Parse positional parameters
     //
@@ -4653,23 +4611,18 @@ ErrorCode callMacro(MacroDefn *defn, Token *locationFieldToken) {
     while (*s != '\0' && pp != NULL && pp->type != MacroParamType_Keyword) {
         s = getParamValue(s, &start, &len);
         if (start == NULL) {
-            freeMacroCall(call);
-            return Err_OperandField;
+            err = Err_OperandField;
+            break;
         }
-        addMacroCallParam(call, pp, start, len);
+        values[pp->index] = start;
+        lens[pp->index] = len;
         if (*s != '\0') s += 1;
         pp = pp->next;
     }
-    if (*s == '\0' && pp != NULL) {
-        while (pp != NULL && pp->type == MacroParamType_Positional) {
-            addMacroCallParam(call, pp, "", 0);
-            pp = pp->next;
-        }
-    }
     //
     //  Parse keyword parameters
     //
-    while (*s != '\0') {
+    while (*s != '\0' && err == Err_None) {
         s = getNextName(s, &keyword, &keywordLen);
         if (keywordLen == 0 || *s != '=') {
             err = Err_OperandField;
@@ -4686,13 +4639,34 @@ ErrorCode callMacro(MacroDefn *defn, Token *locationFieldToken) {
             err = Err_OperandField;
             break;
         }
-        addMacroCallParam(call, pp, value, valueLen);
+        values[pp->index] = value;
+        lens[pp->index] = valueLen;
         if (*s != '\0') s += 1;
     }
     if (err != Err_None) {
-        freeMacroCall(call);
+        free(values);
+        free(lens);
         return err;
     }
+    for (pp = defn->params; pp != NULL; pp = pp->next) {
+        if (values[pp->index] == NULL && pp->type == MacroParamType_Keyword && pp->value != NULL) {
+            values[pp->index] = pp->value;
+            lens[pp->index] = strlen(pp->value);
+        }
+    }
+    size = n * sizeof(char *);
+    for (i = 0; i < n; i++) size += lens[i] + 1;
+    call = (MacroCall *)allocate(sizeof(MacroCall));
+    call->defn = defn;
+    call->values = (char **)allocate(size);
+    cp = (char *)(call->values + n);
+    for (i = 0; i < n; i++) {
+        if (values[i] != NULL) memcpy(cp, values[i], lens[i]);
+        call->values[i] = cp;
+        cp += lens[i] + 1;
+    }
+    free(values);
+    free(lens);
     //
     //  Push the call on the macro call stack
     //
@@ -4809,23 +4783,15 @@ static ErrorCode defineSymbol(u16 attributes) {
 }
 
 /*
- *  findInstruction - find a named instruction definition in the instruction tree
+ *  findInstruction - find a named instruction definition in the instruction index
  */
 NamedInstruction *findInstruction(char *id, int len) {
     NamedInstruction *current;
-    int valence;
 
-    current = namedInstructions;
+    current = instructionIndex[hashId(id, len) & (INSTRUCTION_INDEX_SIZE - 1)];
     while (current != NULL) {
-        valence = strncasecmp(current->id, id, (size_t)len);
-        if (valence > 0)
-            current = current->left;
-        else if (valence < 0)
-            current = current->right;
-        else if (current->id[len] == '\0')
-            break;
-        else
-            current = current->left;
+        if (strncasecmp(current->id, id, (size_t)len) == 0 && current->id[len] == '\0') break;
+        current = current->next;
     }
     return current;
 }
@@ -4849,6 +4815,18 @@ static MacroParam *findMacroParam(MacroDefn *defn, char *name, int len) {
     return NULL;
 }
 
+/*
+ *  findRegisterNode - find the register node of a given register type among a node and its siblings
+ */
+static PatternNode *findRegisterNode(PatternNode *node, RegisterType type) {
+    if (node->index != NULL) return node->index->byRegister[type];
+    while (node != NULL) {
+        if (node->type == NodeType_Register && node->value.regster == type) break;
+        node = node->sibling;
+    }
+    return node;
+}
+
 /*
  *  findSectionLocation - fina a match for the name of a section location
  */
@@ -4905,6 +4883,18 @@ static SectionType findSectionType(char *name, int len) {
     return SectionType_None;
 }
 
+/*
+ *  findTypedNode - find the first node of a given type among a node and its siblings
+ */
+static PatternNode *findTypedNode(PatternNode *node, PatternNodeType type) {
+    if (node->index != NULL) return node->index->byType[type];
+    while (node != NULL) {
+        if (node->type == type) break;
+        node = node->sibling;
+    }
+    return node;
+}
+
 /*
  *  forceInstWordBoundary - advance location and origin counters to next instruction word boundary, if necessary
  */
@@ -4919,30 +4909,12 @@ static void forceInstWordBoundary(void) {
     currentListControl = savedListControl;
 }
 
-/*
- *  freeInstruction - free storage allocated to a named instruction instance
- */
-static void freeInstruction(NamedInstruction *instruction) {
-    free(instruction->id);
-    free(instruction);
-}
-
 void freeMacroCall(MacroCall *call) {
-    MacroParam *pp;
-    MacroParam *ppNext;
-
-    pp = call->params;
-    while (pp != NULL) {
-        ppNext = pp->next;
-        if (pp->name != NULL) free(pp->name);
-        if (pp->value != NULL) free(pp->value);
-        free(pp);
-        pp = ppNext;
-    }
+    if (call->values != NULL) free(call->values);
     free(call);
 }
 
-static void freeMacroDefn(MacroDefn *defn) {
+void freeMacroDefn(MacroDefn *defn) {
     MacroFragment *fp;
     MacroFragment *fpNext;
     MacroParam *pp;
@@ -4961,6 +4933,7 @@ static void freeMacroDefn(MacroDefn *defn) {
         while (fp != NULL) {
            fpNext = fp->next;
            free(fp->text);
+           if (fp->program != NULL) free(fp->program);
            free(fp);
            fp = fpNext;
         }
@@ -4984,7 +4957,7 @@ static void freeMacroDefn(MacroDefn *defn) {
 static Token *generateZero(void) {
     Token *zero;
 
-    zero = (Token *)allocate(sizeof(Token));
+    zero = (Token *)arenaAllocate(&lineArena, sizeof(Token));
     zero->type = TokenType_Number;
     zero->details.number.type = NumberType_Integer;
     return zero;
@@ -5083,7 +5056,6 @@ static char *getParamValue(char *s, char **value, int *valueLen) {
         else {
             *value = NULL;
         }
-        freeToken(expression);
     }
     return s;
 }
@@ -5318,6 +5290,29 @@ static InstPatternDefn instructionPatternDefns[] = {
     {NULL, NULL}
 };
 
+/*
+ *  indexPatterns - attach direct lookup indices to the long sibling lists of the pattern tree
+ */
+static void indexPatterns(PatternNode *node) {
+    PatternIndex *index;
+    int len;
+    PatternNode *sibling;
+
+    len = 0;
+    for (sibling = node; sibling != NULL; sibling = sibling->sibling) {
+        if (sibling->type != NodeType_PatternEnd) indexPatterns(sibling->next);
+        len += 1;
+    }
+    if (len < PATTERN_INDEX_THRESHOLD) return;
+    index = (PatternIndex *)allocate(sizeof(PatternIndex));
+    for (sibling = node; sibling != NULL; sibling = sibling->sibling) {
+        if (index->byType[sibling->type] == NULL) index->byType[sibling->type] = sibling;
+        if (sibling->type == NodeType_Register && index->byRegister[sibling->value.regster] == NULL)
+            index->byRegister[sibling->value.regster] = sibling;
+    }
+    node->index = index;
+}
+
 /*
  *  instInit - build the instruction handler tree
  */
@@ -5332,6 +5327,7 @@ void instInit(void) {
         addPattern(patternDefn->pattern, patternDefn->handler);
         patternDefn += 1;
     }
+    indexPatterns(instructionPatterns);
     /*
      *  Pseudo-instructions
      */
@@ -5509,19 +5505,13 @@ static InstructionHandler matchInstruction(bool *didMatchResultField) {
         s = getNextToken(start, &token);
         switch (token.type) {
         case TokenType_Register:
-            while (TRUE) {
-                if (node->type == NodeType_Register && node->value.regster == token.details.regster.type) break;
-                node = node->sibling;
-                if (node == NULL) return NULL;
-            }
-            instArgv[instArgc++] = copyToken(&token);
+            node = findRegisterNode(node, token.details.regster.type);
+            if (node == NULL) return NULL;
+            instArgv[instArgc++] = copyToken(&token, &lineArena);
             break;
         case TokenType_None:
-            while (TRUE) {
-                if (node->type == NodeType_Expression) break;
-                node = node->sibling;
-                if (node == NULL) return NULL;
-            }
+            node = findTypedNode(node, NodeType_Expression);
+            if (node == NULL) return NULL;
             instArgv[instArgc++] = generateZero();
             break;
         case TokenType_Error:
@@ -5532,11 +5522,8 @@ static InstructionHandler matchInstruction(bool *didMatchResultField) {
         case TokenType_String:
         case TokenType_Operator:
             if (token.type != TokenType_Operator || token.details.operator.type == Op_SubExpr) {
-                while (TRUE) {
-                    if (node->type == NodeType_Expression) break;
-                    node = node->sibling;
-                    if (node == NULL) return NULL;
-                }
+                node = findTypedNode(node, NodeType_Expression);
+                if (node == NULL) return NULL;
                 s = parseExpression(start, &expression);
                 instArgv[instArgc++] = expression;
                 break;
@@ -5612,11 +5599,8 @@ static InstructionHandler matchInstruction(bool *didMatchResultField) {
             else {
                 delimiter = NodeType_PatternEnd;
             }
-            while (TRUE) {
-                if (node->type == delimiter) break;
-                node = node->sibling;
-                if (node == NULL) return NULL;
-            }
+            node = findTypedNode(node, delimiter);
+            if (node == NULL) return NULL;
             *didMatchResultField = TRUE;
             if (node->type == NodeType_PatternEnd) {
                 return node->value.handler;
@@ -5624,11 +5608,8 @@ static InstructionHandler matchInstruction(bool *didMatchResultField) {
             node = node->next;
         }
         else if (*s == ',') {
-            while (TRUE) {
-                if (node->type == NodeType_SubfieldDelimiter) break;
-                node = node->sibling;
-                if (node == NULL) return NULL;
-            }
+            node = findTypedNode(node, NodeType_SubfieldDelimiter);
+            if (node == NULL) return NULL;
             node = node->next;
             s += 1;
         }
@@ -5649,10 +5630,7 @@ static ErrorCode numericMicro(int base) {
 
     err = Err_None;
     if (locationFieldToken->type != TokenType_Name || locationField[0] == '*') err = registerError(Err_LocationField);
-    name = findName(currentModule->micros, locationFieldToken->details.name.ptr, locationFieldToken->details.name.len);
-    if (name == NULL) {
-        name = addName(&currentModule->micros, locationFieldToken->details.name.ptr, locationFieldToken->details.name.len);
-    }
+    name = addMicro(currentModule, locationFieldToken->details.name.ptr, locationFieldToken->details.name.len);
     s = getNextValue(operandField, &val, &err);
     if (err != Err_None) (void)registerError(err);
     if (isSimpleInteger(&val)) {
@@ -6027,7 +6005,6 @@ ErrorCode processMachineInstruction() {
     bool didMatchResultField;
     ErrorCode err;
     InstructionHandler handler;
-    int i;
 
     err = Err_None;
     if (locationFieldToken != NULL) {
@@ -6041,7 +6018,6 @@ ErrorCode processMachineInstruction() {
     else {
         err = didMatchResultField ? Err_OperandField : Err_ResultField;
     }
-    for (i = 0; i < instArgc; i++) freeToken(instArgv[i]);
     return err;
 }
 
@@ -6084,7 +6060,7 @@ static void skipLines(Token *locationFieldToken, int count) {
         }
     }
     else {
-        condToken = copyToken(locationFieldToken);
+        condToken = copyToken(locationFieldToken, &lineArena);
         while (isEof() == FALSE) {
             listFlush(currentSection);
             readNextLine();
@@ -6100,6 +6076,5 @@ static void skipLines(Token *locationFieldToken, int count) {
                     break;
             }
         }
-        freeToken(condToken);
     }
 }
@@ -30,7 +30,11 @@
 #include "caltypes.h"
 #include "services.h"
 
-static char *getMacroParamValue(MacroCall *call, char *name);
+static int  currentLineIndex = -1;
+static int  sourceLineCount = 0;
+static int  sourceLineIndex = 0;
+static int  sourceLineLimit = 0;
+static char **sourceLineStarts = NULL;
 
 static void generateMacroLine(void) {
     MacroCall *call;
@@ -45,6 +49,7 @@ static void generateMacroLine(void) {
     char *tp;
 
     listControlMask = LIST_ON|LIST_MAC;
+    assemblyStats.macroLinesGenerated += 1;
     call = macroStack[macroStackPtr - 1];
     line = call->nextLine;
     sp = sourceLine;
@@ -55,10 +60,10 @@ static void generateMacroLine(void) {
             tp = frag->text;
         }
         else {
-            tp = getMacroParamValue(call, frag->text);
+            tp = call->values[frag->paramIndex];
             if (frag->next != NULL && frag->next->type == MacroFragType_Regex) {
                 frag = frag->next;
-                rc = applyRE(frag->text, strlen(frag->text), tp, strlen(tp), reCaptures, reCaptureLens, 10, &reCaptureN);
+                rc = applyCompiledRE(frag->program, tp, strlen(tp), reCaptures, reCaptureLens, 10, &reCaptureN);
                 if (rc == 1 && reCaptureN > 0) {
                     tp = reCaptures[0];
                     while (sp < limit && reCaptureLens[0]-- > 0) *sp++ = *tp++;
@@ -77,76 +82,105 @@ static void generateMacroLine(void) {
     }
 }
 
-static char *getMacroParamValue(MacroCall *call, char *name) {
-    MacroParam *pp;
+/*
+**  getSourceLineIndex - return the index of the line in sourceLine within
+**  the current source file, or -1 if the line was generated by a macro
+*/
+int getSourceLineIndex(void) {
+    return currentLineIndex;
+}
 
-    //
-    //  First, look for a matching actual parameter in the
-    //  call structure.
-    //
-    pp = call->params;
-    while (pp != NULL) {
-        if (strcasecmp(name, pp->name) == 0) return pp->value;
-        pp = pp->next;
+int isEof(void) {
+    return (sourceLineIndex >= sourceLineCount) ? TRUE : FALSE;
+}
+
+/*
+**  loadSource - read the current source file into memory and record the
+**               boundaries of its lines, so that each pass can iterate over
+**               the lines without re-reading the file
+*/
+void loadSource(void) {
+    char *cp;
+    char *limit;
+    int n;
+    int size;
+
+    size = 0;
+    sourceBufferLength = 0;
+    while (TRUE) {
+        if (sourceBufferLength >= size) {
+            sourceBuffer = (char *)reallocate(sourceBuffer, size, size + SOURCE_BUFFER_INCREMENT);
+            size += SOURCE_BUFFER_INCREMENT;
+        }
+        n = fread(sourceBuffer + sourceBufferLength, 1, size - sourceBufferLength, sourceFile);
+        if (n < 1) break;
+        sourceBufferLength += n;
+    }
+    if (ferror(sourceFile)) {
+        perror(sourceFilePath);
+        exit(1);
     }
     //
-    //  If no match against actual parameters, find a matching
-    //  keyword parameter and return its default value.
+    //  Each line begins where the previous one's newline ended. The final
+    //  line runs to the end of the buffer and might be empty, in which
+    //  case it mirrors the empty read that detects end of file.
     //
-    pp = call->defn->params;
-    while (pp != NULL) {
-        if (pp->type == MacroParamType_Keyword && strcasecmp(name, pp->name) == 0)
-            return pp->value;
-        pp = pp->next;
+    sourceLineCount = 0;
+    cp = sourceBuffer;
+    limit = sourceBuffer + sourceBufferLength;
+    while (TRUE) {
+        if (sourceLineCount + 1 >= sourceLineLimit) {
+            sourceLineStarts = (char **)reallocate(sourceLineStarts, sourceLineLimit * sizeof(char *),
+                (sourceLineLimit + SOURCE_LINE_INCREMENT) * sizeof(char *));
+            sourceLineLimit += SOURCE_LINE_INCREMENT;
+        }
+        sourceLineStarts[sourceLineCount++] = cp;
+        cp = memchr(cp, '\n', limit - cp);
+        if (cp == NULL) break;
+        cp += 1;
     }
-    return "";
-}
-
-int isEof(void) {
-    return (feof(sourceFile) != 0) ? TRUE : FALSE;
+    sourceLineStarts[sourceLineCount] = limit + 1;
+    sourceLineIndex = 0;
 }
 
 void readNextLine(void) {
-    int c;
+    char c;
+    char *cp;
     int i;
+    char *limit;
     int lineEnd;
-    int result;
 
     if (macroStackPtr > 0) {
+        currentLineIndex = -1;
         generateMacroLine();
         return;
     }
     i = 0;
     lineEnd = 0;
-    while (TRUE) {
-        c = fgetc(sourceFile);
-        if (c == EOF) {
-            if (feof(sourceFile)) {
-                sourceLine[i] = '\0';
-                break;
-            }
-            else {
-                perror(sourceFilePath);
-                exit(1);
-            }
-        }
+    currentLineIndex = -1;
+    if (sourceLineIndex < sourceLineCount) {
+        currentLineIndex = sourceLineIndex;
+        cp = sourceLineStarts[sourceLineIndex];
+        limit = sourceLineStarts[sourceLineIndex + 1] - 1;
+        if (pass == 1 && cp < sourceBuffer + sourceBufferLength) assemblyStats.linesRead += 1;
+        sourceLineIndex += 1;
+        while (cp < limit) {
+            c = *cp++;
 #if 0  /* defined(__cos) */
-        else if (c == 0x1b) {
-            /*
-             * Handle COS blank compression indicator
-             */
-            c = fgetc(sourceFile);
-            if (c == EOF) break;
-            c -= 036; /* blank count is biased by 36 octal */
-            while (c-- > 0 && i < MAX_SOURCE_LINE_LENGTH) sourceLine[i++] = ' ';
-        }
+            if (c == 0x1b) {
+                /*
+                 * Handle COS blank compression indicator
+                 */
+                if (cp >= limit) break;
+                c = *cp++ - 036; /* blank count is biased by 36 octal */
+                while (c-- > 0 && i < MAX_SOURCE_LINE_LENGTH) sourceLine[i++] = ' ';
+                continue;
+            }
 #endif
-        else if (c == '\n') {
-            break;
-        }
-        else if (i < MAX_SOURCE_LINE_LENGTH) {
-            sourceLine[i++] = c;
-            if (c != ' ') lineEnd = i;
+            if (i < MAX_SOURCE_LINE_LENGTH) {
+                sourceLine[i++] = c;
+                if (c != ' ') lineEnd = i;
+            }
         }
     }
     sourceLine[lineEnd] = '\0';
@@ -193,3 +227,10 @@ void readNextLine(void) {
         }
     }
 }
+
+/*
+**  rewindSource - position to the first line of the current source file
+*/
+void rewindSource(void) {
+    sourceLineIndex = 0;
+}
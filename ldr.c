@@ -24,6 +24,7 @@
 
 #define DEBUG 0
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -38,28 +39,29 @@
 #include "services.h"
 
 static void addBlock(Module *module, Block *block);
+static void addEntryPoints(Module *module);
 static bool addLibraryModule(Module *module);
 static Symbol *addSymbol(u8 *id, Block *block, u64 value, bool isParcelAddress);
 static void addSuffix(char *inPath, char *suffix, char *outPath);
 static bool addUnsatisfiedExternal(u8 *id);
 static void adjustEntryPoints(Symbol *symbol);
+static int cacheTable(Dataset *ds, u64 hdr, int tableLength);
 static void calculateBaseAddresses(Block *block);
 static void calculateCommonBaseAddresses(Block *block);
 static void calculateModuleName(char *path, u8 *name);
-static int collectLibraryModules(Dataset *ds, char *sourcePath);
+static int collectLibraryModules(Dataset *ds, int libraryIndex);
 static Block *findBlock(Module *module, int blockIndex);
 static Module *findLibraryEntry(u8 *id);
 static Module *findLibraryModule(u8 *id);
 static Symbol *findSymbol(u8 *id);
-static u64 formMask(int len);
-static u64 getField(u8 *bytes, u32 rightmostBit, u16 fieldLength);
 static char *getTableType(u8 type);
 static u64 getWord(u8 *bytes);
+static u32 hashEntryName(u8 *id);
 static int idcmp(u8 *id1, u8*id2, int len);
-static int isLibrary(Dataset *ds, int pass, char *sourcePath);
-static int loadLibraryModule(Dataset *ds, Module *module, char *libraryPath, int pass, u64 *tableHeader);
-static int loadLibraryModules(int pass);
-static int loadObjectModules(Dataset *ds, u8 *moduleId, int pass);
+static int isLibrary(Dataset *ds, char *sourcePath);
+static int loadLibraryModule(Dataset *ds, Module *module, char *libraryPath, u64 *tableHeader);
+static int loadLibraryModules(void);
+static int loadObjectModules(Dataset *ds, u8 *moduleId);
 static int locateTable(Dataset *ds, u8 tableType, u64 *hdr, int *tableLength, char *sourcePath);
 static int parseOptions(int argc, char *argv[]);
 static void printAddress(u32 address, bool isParcelAddress);
@@ -67,13 +69,15 @@ static void printLoadMap(void);
 static void printModuleSummary(Module *module);
 static void printSymbol(Symbol *symbol, bool doDisplayModule);
 static void printSymbols(Module *module, Symbol *symbol);
-static int processBRT(Dataset *ds, u64 hdr, int tableLength);
+static int processBRT(u64 hdr, u8 *table, int tableLength);
+static int processDFT(u8 *table, int tableLength, char *sourcePath, bool isDirectory);
 static int processPDT(Dataset *ds, u8 *moduleId, u64 hdr, u8 *table, int tableLength);
-static int processTXT(Dataset *ds, u64 hdr, int tableLength);
-static int processXRT(Dataset *ds, u64 hdr, int tableLength);
-static void putField(u8 *bytes, u32 rightmostBit, u16 fieldLength, u64 field);
+static int processTables(Module *module);
+static int processTXT(u64 hdr, u8 *table, int tableLength);
+static int processXRT(u64 hdr, u8 *table, int tableLength);
 static void putWord(u8 *bytes, u64 word);
-static int readWord(Dataset *ds, u64 *word);
+static void relocateField(u32 rightmostBit, u16 fieldLength, u64 increment);
+static void resizeEntryIndex(void);
 static bool resolveExternal(u8 *id);
 static void resolveExternals(void);
 static bool resolveModuleExternals(Module *module);
@@ -89,19 +93,25 @@ static char   currentDate[9];
 static char   currentTime[9];
 static u32    blockLimit = 0200;
 static Module *currentModule = NULL;
+static int    entryPointCount = 0;
+static EntryPoint **entryPointIndex = NULL;
+static u32    entryPointIndexSize = 0;
 static int    errorCount = 0;
 static Block  *firstBlocks[BlockTypes] = {NULL,NULL,NULL,NULL,NULL,NULL,NULL};
+static EntryPoint *firstEntryPoint = NULL;
 static Module *firstLibraryModule = NULL;
 static Module *firstObjectModule = NULL;
 static bool   hasErrorFlag = FALSE;
-static u8     *image = NULL;
+static u64    *image = NULL;
 static int    imageSize = 0;
+static EntryPoint *lastEntryPoint = NULL;
 static Module *lastLibraryModule = NULL;
 static Module *lastObjectModule = NULL;
 static Module *libraryModuleTree;
 static char   *ldrName = "kLDR";
 static char   *ldrVersion = "1.0";
 static int    libraryCount = 0;
+static bool   libraryHasDirectory[MAX_LIBRARIES];
 static char   *libraryPaths[MAX_LIBRARIES];
 static FILE   *loadMap = NULL;
 static char   *mFile = NULL;
@@ -138,9 +148,9 @@ int main(int argc, char *argv[]) {
     int fileIndex;
     char *filePath;
     int i;
+    Module *module;
     u8 moduleId[9];
     char objectPath[MAX_FILE_PATH_LENGTH+1];
-    int pass;
     char sourcePath[MAX_FILE_PATH_LENGTH+1];
     char *sp;
     int status;
@@ -211,81 +221,84 @@ int main(int argc, char *argv[]) {
     //
     //  Execute the load in two passes. In pass one, process PDT's
     //  to build a module chain, create a symbol table of entry points,
-    //  and calculate total image size. In pass two, process TXT's
-    //  to load code and data into the image, process BRT's to perform
-    //  relocation, and process XRT's to resolve external references.
+    //  and calculate total image size. The TXT's, BRT's, and XRT's of
+    //  the modules to be loaded are read into memory as they are
+    //  encountered, so each object file and library is opened and read
+    //  only in pass one. In pass two, process the TXT's to load code and
+    //  data into the image, the BRT's to perform relocation, and the XRT's
+    //  to resolve external references.
     //  
-    for (pass = 1; pass <= 2; pass++) {
 #if DEBUG
-        eprintf("Start pass %d", pass);
+    eputs("Start pass 1");
 #endif
-        currentModule = NULL;
-        fileIndex = 0;
-
-        while (fileIndex < sourceCount) {
-            filePath = sourcePaths[fileIndex++];
-            ds = cosDsOpen(filePath);
-            if (ds == NULL) {
-                eprintf("Failed to open %s", filePath);
-                exit(1);
-            }
-            status = isLibrary(ds, pass, filePath);
+    currentModule = NULL;
+    fileIndex = 0;
+
+    while (fileIndex < sourceCount) {
+        filePath = sourcePaths[fileIndex++];
+        ds = cosDsOpen(filePath);
+        if (ds == NULL) {
+            eprintf("Failed to open %s", filePath);
+            exit(1);
+        }
+        status = isLibrary(ds, filePath);
 #if DEBUG
-            if (status != -1) eprintf("%s is %s", filePath, status == 0 ? "an object file" : "a library");
+        if (status != -1) eprintf("%s is %s", filePath, status == 0 ? "an object file" : "a library");
 #endif
-            if (status == -1) {
-                eprintf("Failed to read %s", filePath);
+        if (status == -1) {
+            eprintf("Failed to read %s", filePath);
+            exit(1);
+        }
+        else if (status == 0) {
+            calculateModuleName(filePath, moduleId);
+            if (loadObjectModules(ds, moduleId) == -1) {
+                eprintf("Failed to load object modules from %s", filePath);
                 exit(1);
             }
-            else if (status == 0) {
-                calculateModuleName(filePath, moduleId);
-                if (loadObjectModules(ds, moduleId, pass) == -1) {
-                    eprintf("Failed to load object modules from %s", filePath);
-                    exit(1);
-                }
-            }
-            else if (pass == 1) {
-                if (collectLibraryModules(ds, filePath) == -1) {
-                    eprintf("Failed to read entry names from %s", filePath);
-                    exit(1);
-                }
-            }
-            cosDsClose(ds);
         }
-        if (pass == 1) {
+        else if (collectLibraryModules(ds, libraryCount - 1) == -1) {
+            eprintf("Failed to read entry names from %s", filePath);
+            exit(1);
+        }
+        cosDsClose(ds);
+    }
 #if DEBUG
-            eputs("Resolve externals");
+    eputs("Resolve externals");
 #endif
-            resolveExternals();
-            if (loadLibraryModules(pass) == -1) exit(1);
-            //
-            //  Traverse the block lists and calculate the base address of
-            //  each block based upon the load order
-            //
+    resolveExternals();
+    if (loadLibraryModules() == -1) exit(1);
+    //
+    //  Traverse the block lists and calculate the base address of
+    //  each block based upon the load order
+    //
 #if DEBUG
-            eputs("Calculate base addresses");
+    eputs("Calculate base addresses");
 #endif
-            calculateBaseAddresses(firstBlocks[BlockType_Code]);
-            calculateBaseAddresses(firstBlocks[BlockType_Mixed]);
-            calculateBaseAddresses(firstBlocks[BlockType_Const]);
-            calculateBaseAddresses(firstBlocks[BlockType_Data]);
-            calculateCommonBaseAddresses(firstBlocks[BlockType_Common]);
-            calculateCommonBaseAddresses(firstBlocks[BlockType_TaskCom]);
-            calculateBaseAddresses(firstBlocks[BlockType_Dynamic]);
-            imageSize *= 8;
-            image = (u8 *)allocate(imageSize);
+    calculateBaseAddresses(firstBlocks[BlockType_Code]);
+    calculateBaseAddresses(firstBlocks[BlockType_Mixed]);
+    calculateBaseAddresses(firstBlocks[BlockType_Const]);
+    calculateBaseAddresses(firstBlocks[BlockType_Data]);
+    calculateCommonBaseAddresses(firstBlocks[BlockType_Common]);
+    calculateCommonBaseAddresses(firstBlocks[BlockType_TaskCom]);
+    calculateBaseAddresses(firstBlocks[BlockType_Dynamic]);
+    image = (u64 *)allocate(imageSize * 8);
 #if DEBUG
-            eputs("Adjust entry points");
+    eputs("Adjust entry points");
 #endif
-            adjustEntryPoints(symbolTable);
-        }
-        else {
-            if (loadLibraryModules(pass) == -1) exit(1);
-        }
+    adjustEntryPoints(symbolTable);
 #if DEBUG
-        eprintf("End pass   %d", pass);
+    eputs("End pass   1");
+    eputs("Start pass 2");
 #endif
+    for (module = firstObjectModule; module != NULL; module = module->next) {
+        if (processTables(module) == -1) exit(1);
+    }
+    for (module = firstLibraryModule; module != NULL; module = module->next) {
+        if (module->doLoad && processTables(module) == -1) exit(1);
     }
+#if DEBUG
+    eputs("End pass   2");
+#endif
 #if defined(__cos)
     if (oFile != NULL) {
 #if DEBUG
@@ -392,6 +405,36 @@ static void addBlock(Module *module, Block *block) {
     }
 }
 
+static void addEntryPoints(Module *module) {
+    EntryPoint *entryPoint;
+    int i;
+    u8 *id;
+    EntryPoint **slot;
+
+    //
+    //  When more than one library module defines an entry point, the first
+    //  one collected satisfies references to it
+    //
+    for (i = 0, id = module->entryTable; i < module->entryCount; i++, id += 8) {
+        if (findLibraryEntry(id) != NULL) continue;
+        if (entryPointCount >= entryPointIndexSize) resizeEntryIndex();
+        entryPoint = (EntryPoint *)allocate(sizeof(EntryPoint));
+        entryPoint->id = id;
+        entryPoint->module = module;
+        slot = &entryPointIndex[hashEntryName(id) & (entryPointIndexSize - 1)];
+        entryPoint->nextInChain = *slot;
+        *slot = entryPoint;
+        if (firstEntryPoint == NULL) {
+            firstEntryPoint = entryPoint;
+        }
+        else {
+            lastEntryPoint->next = entryPoint;
+        }
+        lastEntryPoint = entryPoint;
+        entryPointCount += 1;
+    }
+}
+
 static bool addLibraryModule(Module *module) {
     Module *current;
     int valence;
@@ -548,6 +591,28 @@ static void adjustEntryPoints(Symbol *symbol) {
     adjustEntryPoints(symbol->right);
 }
 
+static int cacheTable(Dataset *ds, u64 hdr, int tableLength) {
+    int length;
+    int newSize;
+
+    //
+    //  Append the table, preceded by its header, to the tables of the
+    //  current module that are processed in pass two
+    //
+    length = currentModule->tableCacheLength + 8 + tableLength;
+    if (length > currentModule->tableCacheSize) {
+        newSize = currentModule->tableCacheSize * 2;
+        if (newSize < length) newSize = length + TABLE_CACHE_INCREMENT;
+        currentModule->tableCache = (u8 *)reallocate(currentModule->tableCache, currentModule->tableCacheSize, newSize);
+        currentModule->tableCacheSize = newSize;
+    }
+    putWord(currentModule->tableCache + currentModule->tableCacheLength, hdr);
+    if (cosDsRead(ds, currentModule->tableCache + currentModule->tableCacheLength + 8, tableLength) != tableLength)
+        return -1;
+    currentModule->tableCacheLength = length;
+    return 0;
+}
+
 static void calculateBaseAddresses(Block *block) {
     u32 limit;
 
@@ -644,29 +709,37 @@ static void calculateModuleName(char *path, u8 *name) {
     }
 }
 
-static int collectLibraryModules(Dataset *ds, char *sourcePath) {
-    int blockWordCount;
-    u8 *entries;
-    int entryWordCount;
-    int externWordCount;
+static int collectLibraryModules(Dataset *ds, int libraryIndex) {
     u64 hdr;
-    Module *module;
     int n;
-    int offset;
+    long position;
+    char *sourcePath;
     int status;
     u8 *table;
     int tableLength;
-    u64 word;
 
+    sourcePath = libraryPaths[libraryIndex];
+    status = 0;
     //
-    //  Locate and process all DFT's
+    //  A library may end with a directory, a DFT with an entry for every
+    //  module in the library, in a file of its own. When it has one, read
+    //  the directory instead of the DFT's preceding the modules, so that
+    //  modules can be loaded later without reading the entire library.
     //
-    for (;;) {
+    position = cosDsLastFilePosition(ds);
+    if (position > 0 && cosDsSeek(ds, position) == 0) {
         status = locateTable(ds, LDR_TT_DFT, &hdr, &tableLength, sourcePath);
-        if (status == -1 || status == 0) return status;
-        //
-        //  Process a DFT
-        //
+        if (status == -1) return -1;
+        libraryHasDirectory[libraryIndex] = (status == 1);
+    }
+    if (libraryHasDirectory[libraryIndex] == FALSE) {
+        if (cosDsRewind(ds) == -1) return -1;
+        status = locateTable(ds, LDR_TT_DFT, &hdr, &tableLength, sourcePath);
+    }
+    //
+    //  Process all DFT's
+    //
+    while (status == 1) {
         table = (u8 *)allocate(tableLength);
         n = cosDsRead(ds, table, tableLength);
         if (n != tableLength) {
@@ -674,60 +747,27 @@ static int collectLibraryModules(Dataset *ds, char *sourcePath) {
             free(table);
             return -1;
         }
-        word = getWord(table);
-        externWordCount = (word >> 24) & 0x7fff;
-        entryWordCount  = (word >> 9) & 0x7fff;
-        blockWordCount  = word & 0x1ff;
-        if (entryWordCount > 0 || externWordCount > 0) {
-            module = (Module *)allocate(sizeof(Module));
-            module->libraryPath = sourcePath;
-            offset = 8;
-            memcpy(module->id, table + offset, 8);
-            offset += (blockWordCount * 8) + 16;
-            if (entryWordCount > 0) {
-                module->entryCount = entryWordCount;
-                n = entryWordCount * 8;
-                entries = (u8 *)allocate(n);
-                module->entryTable = entries;
-                memcpy(entries, table + offset, n);
-                offset += n;
-            }
-            if (externWordCount > 0) {
-                module->externalRefCount = externWordCount;
-                n = externWordCount * 8;
-                entries = (u8 *)allocate(n);
-                module->externalRefTable = entries;
-                memcpy(entries, table + offset, n);
-                offset += n;
-            }
-#if DEBUG
-            eprintf("Collect %d entry names and %d external reference names from module %.8s of library %s", entryWordCount, externWordCount, module->id, sourcePath);
-#endif
-            if (addLibraryModule(module) == FALSE) {
-                eprintf("WARNING: Duplicate module name %.8s in library %s", module->id, sourcePath);
-            }
-        }
+        status = processDFT(table, tableLength, sourcePath, libraryHasDirectory[libraryIndex]);
         free(table);
+        if (status == -1) return -1;
+        status = locateTable(ds, LDR_TT_DFT, &hdr, &tableLength, sourcePath);
     }
+
+    return status;
 }
 
 static Block *findBlock(Module *module, int blockIndex) {
-    Block *block;
-
-    block = module->firstBlock;
-    while (blockIndex-- > 0 && block != NULL) block = block->nextInModule;
-    return block;
+    return (blockIndex < module->blockCount) ? module->blocks[blockIndex] : NULL;
 }
 
 static Module *findLibraryEntry(u8 *id) {
-    int i;
-    Module *module;
-    int offset;
+    EntryPoint *entryPoint;
 
-    for (module = firstLibraryModule; module != NULL; module = module->next) {
-        for (i = 0, offset = 0; i < module->entryCount; i++, offset += 8) {
-            if (idcmp(id, module->entryTable + offset, 8) == 0) return module;
-        }
+    if (entryPointIndex == NULL) return NULL;
+    entryPoint = entryPointIndex[hashEntryName(id) & (entryPointIndexSize - 1)];
+    while (entryPoint != NULL) {
+        if (idcmp(id, entryPoint->id, 8) == 0) return entryPoint->module;
+        entryPoint = entryPoint->nextInChain;
     }
 
     return NULL;
@@ -767,39 +807,6 @@ static Symbol *findSymbol(u8 *id) {
     return current;
 }
 
-static u64 formMask(int len) {
-    u64 mask;
-
-    switch (len) {
-    case 8:
-        mask = 0xff;
-        break;
-    case 16:
-        mask = 0xffff;
-        break;
-    case 22:
-        mask = 0x3fffff;
-        break;
-    case 24:
-        mask = 0xffffff;
-        break;
-    case 32:
-        mask = 0xffffffff;
-        break;
-    case 64:
-        mask = 0xffffffffffffffff;
-        break;
-    default:
-        mask = 0;
-        while (len-- > 0) {
-            mask = (mask << 1) | 1;
-        }
-        break;
-    }
-
-    return mask;
-}
-
 static char *getBlockType(BlockType type) {
     switch (type) {
     case BlockType_Common : return "Common";
@@ -814,28 +821,6 @@ static char *getBlockType(BlockType type) {
     return "Unknown";
 }
 
-static u64 getField(u8 *bytes, u32 rightmostBit, u16 fieldLength) {
-    u32 byteOffset;
-    u64 field;
-    u64 mask;
-    int shiftCount;
-
-    byteOffset = (rightmostBit >> 3) - 7;
-    mask = formMask(fieldLength);
-    if ((rightmostBit & 7) == 7) { /* byte-aligned */
-        field = getWord(bytes + byteOffset);
-    }
-    else {
-        field = getWord(bytes + byteOffset);
-        shiftCount = 7 - (rightmostBit & 7);
-        field >>= shiftCount;
-        if (fieldLength >= 56) {
-            field = field | ((u64)bytes[byteOffset - 1] << (64 - shiftCount));
-        }
-    }
-    return field & mask;
-}
-
 static char *getTableType(u8 type) {
     switch (type) {
     case LDR_TT_PWT: return "PWT";
@@ -862,59 +847,60 @@ static u64 getWord(u8 *bytes) {
     return word;
 }
 
+static u32 hashEntryName(u8 *id) {
+    char c;
+    Fnv32_t hash;
+    int i;
+
+    //
+    //  Hash the name as idcmp compares it, ignoring case and ending at NUL
+    //
+    hash = FNV1_32A_INIT;
+    for (i = 0; i < 8 && id[i] != '\0'; i++) {
+        c = toupper(id[i]);
+        hash = fnv32a(&c, 1, hash);
+    }
+    return hash;
+}
+
 static int idcmp(u8 *id1, u8 *id2, int len) {
     return strncasecmp((char *)id1, (char *)id2, len);
 }
 
-static int isLibrary(Dataset *ds, int pass, char *sourcePath) {
+static int isLibrary(Dataset *ds, char *sourcePath) {
     u8 buf[8];
-    char *cp;
     u64 hdr;
-    int i;
     int n;
     int status;
     u8 tableType;
 
     status = 0;
-    if (pass == 1) {
-        n = cosDsRead(ds, buf, 8);
-        cosDsRewind(ds);
-        if (n != 8) return -1;
-        hdr = getWord(buf);
-        tableType = hdr >> 60;
-        if (tableType == LDR_TT_DFT) {
-            if (libraryCount >= MAX_LIBRARIES) {
-                eprintf("Too many libraries specified, max is %d", MAX_LIBRARIES);
-                exit(1);
-            }
-            libraryPaths[libraryCount++] = sourcePath;
-            status = 1;
-        }
-    }
-    else {
-        for (i = 0; i < libraryCount; i++) {
-            if (strcmp(libraryPaths[i], sourcePath) == 0) {
-                status = 1;
-                break;
-            }
+    n = cosDsRead(ds, buf, 8);
+    cosDsRewind(ds);
+    if (n != 8) return -1;
+    hdr = getWord(buf);
+    tableType = hdr >> 60;
+    if (tableType == LDR_TT_DFT) {
+        if (libraryCount >= MAX_LIBRARIES) {
+            eprintf("Too many libraries specified, max is %d", MAX_LIBRARIES);
+            exit(1);
         }
+        libraryPaths[libraryCount++] = sourcePath;
+        status = 1;
     }
 
     return status;
 }
 
-static int loadLibraryModule(Dataset *ds, Module *module, char *libraryPath, int pass, u64 *tableHeader) {
+static int loadLibraryModule(Dataset *ds, Module *module, char *libraryPath, u64 *tableHeader) {
     u8 buf[8];
     u64 hdr;
-    bool isFound;
     int n;
-    int offset;
     int status;
     u8 *table;
     int tableLength;
     u8 tableType;
     u64 wc;
-    u64 word;
 
 #if DEBUG
     eprintf("Load module %.8s from library %s", module->id, libraryPath);
@@ -930,63 +916,53 @@ static int loadLibraryModule(Dataset *ds, Module *module, char *libraryPath, int
 
     currentModule = module;
 
-    if (pass == 1) {
-        table = (u8 *)allocate(tableLength);
-        n = cosDsRead(ds, table, tableLength);
-        if (n != tableLength) {
-            eprintf("Failed to read PDT in %s", libraryPath);
-            free(table);
-            return -1;
-        }
-        if (processPDT(ds, module->id, hdr, table, tableLength) == -1) {
-            free(table);
-            return -1;
-        }
+    table = (u8 *)allocate(tableLength);
+    n = cosDsRead(ds, table, tableLength);
+    if (n != tableLength) {
+        eprintf("Failed to read PDT in %s", libraryPath);
         free(table);
-
-        return 0; /* locate next DFT */
+        return -1;
+    }
+    if (processPDT(ds, module->id, hdr, table, tableLength) == -1) {
+        free(table);
+        return -1;
     }
-    else { // pass 2
-        if (skipBytes(ds, tableLength) == -1) {
-            eprintf("Failed to skip PDT in %s", libraryPath);
+    free(table);
+
+    for (;;) {
+        n = cosDsRead(ds, buf, 8);
+        if (n == -1) {
+            eprintf("Failed to read library %s", libraryPath);
             return -1;
         }
-        for (;;) {
-            n = cosDsRead(ds, buf, 8);
-            if (n == -1) {
-                eprintf("Failed to read library %s", libraryPath);
+        if (n == 0) return 2; /* end of file */
+        hdr = getWord(buf);
+        tableType = hdr >> 60;
+        wc = (hdr >> 36) & 0xffffff; // word count for most table types
+        tableLength = (wc - 1) * 8;
+        switch (tableType) {
+        case LDR_TT_XRT:
+        case LDR_TT_BRT:
+        case LDR_TT_TXT:
+            if (cacheTable(ds, hdr, tableLength) == -1) {
+                eprintf("Failed to read %s in %s", getTableType(tableType), libraryPath);
                 return -1;
             }
-            if (n == 0) return 2; /* end of file */
-            hdr = getWord(buf);
-            tableType = hdr >> 60;
-            wc = (hdr >> 36) & 0xffffff; // word count for most table types
-            tableLength = (wc - 1) * 8;
-            switch (tableType) {
-            case LDR_TT_XRT:
-                if (processXRT(ds, hdr, tableLength) == -1) return -1;
-                break;
-            case LDR_TT_BRT:
-                if (processBRT(ds, hdr, tableLength) == -1) return -1;
-                break;
-            case LDR_TT_TXT:
-                if (processTXT(ds, hdr, tableLength) == -1) return -1;
-                break;
-            case LDR_TT_DFT:
-                *tableHeader = hdr;
-                return 1; /* positioned at DFT header */
-            default:
-                if (skipBytes(ds, tableLength) == -1) {
-                    eprintf("Failed to skip %s in %s", getTableType(tableType), libraryPath);
-                    return -1;
-                }
-                break;
+            break;
+        case LDR_TT_DFT:
+            *tableHeader = hdr;
+            return 1; /* positioned at DFT header */
+        default:
+            if (skipBytes(ds, tableLength) == -1) {
+                eprintf("Failed to skip %s in %s", getTableType(tableType), libraryPath);
+                return -1;
             }
+            break;
         }
     }
 }
 
-static int loadLibraryModules(int pass) {
+static int loadLibraryModules(void) {
     Dataset *ds;
     u64 hdr;
     int i;
@@ -1006,6 +982,37 @@ static int loadLibraryModules(int pass) {
             eprintf("Failed to open %s", path);
             return -1;
         }
+        //
+        //  When the library has a directory, seek to each module to be
+        //  loaded instead of reading the entire library.
+        //
+        if (libraryHasDirectory[i]) {
+            for (module = firstLibraryModule; module != NULL; module = module->next) {
+                if (module->libraryPath != path || module->doLoad == FALSE) continue;
+                if (cosDsSeek(ds, module->position) == -1
+                    || locateTable(ds, LDR_TT_DFT, &hdr, &tableLength, path) != 1) {
+                    eprintf("Failed to locate module %.8s in %s", module->id, path);
+                    cosDsClose(ds);
+                    return -1;
+                }
+                table = (u8 *)allocate(tableLength);
+                n = cosDsRead(ds, table, tableLength);
+                if (n != tableLength || idcmp(table + 8, module->id, 8) != 0) {
+                    eprintf("Directory of %s does not match module %.8s", path, module->id);
+                    free(table);
+                    cosDsClose(ds);
+                    return -1;
+                }
+                free(table);
+                if (loadLibraryModule(ds, module, path, &hdr) == -1) {
+                    eprintf("Failed to load module %.8s from %s", module->id, path);
+                    cosDsClose(ds);
+                    return -1;
+                }
+            }
+            cosDsClose(ds);
+            continue;
+        }
         state = 0;
         for (;;) {
             /*
@@ -1044,7 +1051,7 @@ static int loadLibraryModules(int pass) {
             moduleId = table + 8;
             module = findLibraryModule(moduleId);
             if (module != NULL && module->doLoad) {
-                state = loadLibraryModule(ds, module, path, pass, &hdr);
+                state = loadLibraryModule(ds, module, path, &hdr);
                 if (state == -1) {
                     eprintf("Failed to load module %.8s from %s", moduleId, path);
                     free(table);
@@ -1059,7 +1066,7 @@ static int loadLibraryModules(int pass) {
     return 0;
 }
 
-static int loadObjectModules(Dataset *ds, u8 *moduleId, int pass) {
+static int loadObjectModules(Dataset *ds, u8 *moduleId) {
     u8 buf[8];
     u64 cw;
     u64 hdr;
@@ -1087,56 +1094,37 @@ static int loadObjectModules(Dataset *ds, u8 *moduleId, int pass) {
         tableLength = (wc - 1) * 8;
         switch (tableType) {
         case LDR_TT_XRT:
-            if (pass == 2) {
-                if (processXRT(ds, hdr, tableLength) == -1) return -1;
-                continue;
-            }
-            break;
         case LDR_TT_BRT:
-            if (pass == 2) {
-                if (processBRT(ds, hdr, tableLength) == -1) return -1;
-                continue;
-            }
-            break;
         case LDR_TT_TXT:
-            if (pass == 2) {
-                if (processTXT(ds, hdr, tableLength) == -1) return -1;
+            if (currentModule != NULL) {
+                if (cacheTable(ds, hdr, tableLength) == -1) return -1;
                 continue;
             }
             break;
         case LDR_TT_PDT:
-            if (pass == 1) {
-                table = (u8 *)allocate(tableLength);
-                n = cosDsRead(ds, table, tableLength);
-                if (n != tableLength) {
-                    free(table);
-                    return -1;
-                }
-                //
-                //  Append new module to module list
-                //
-                module = (Module *)allocate(sizeof(Module));
-                memcpy(module->id, moduleId, 8);
-                if (firstObjectModule == NULL)
-                    firstObjectModule = module;
-                else
-                    lastObjectModule->next = module;
-                lastObjectModule = currentModule = module;
-
-                if (processPDT(ds, moduleId, hdr, table, tableLength) == -1) {
-                    free(table);
-                    return -1;
-                }
+            table = (u8 *)allocate(tableLength);
+            n = cosDsRead(ds, table, tableLength);
+            if (n != tableLength) {
                 free(table);
-                continue;
-            }
-            else if (currentModule == NULL) {
-                currentModule = firstObjectModule;
+                return -1;
             }
-            else {
-                currentModule = currentModule->next;
+            //
+            //  Append new module to module list
+            //
+            module = (Module *)allocate(sizeof(Module));
+            memcpy(module->id, moduleId, 8);
+            if (firstObjectModule == NULL)
+                firstObjectModule = module;
+            else
+                lastObjectModule->next = module;
+            lastObjectModule = currentModule = module;
+
+            if (processPDT(ds, moduleId, hdr, table, tableLength) == -1) {
+                free(table);
+                return -1;
             }
-            break;
+            free(table);
+            continue;
         case LDR_TT_DFT:
             wc = (hdr >> 24) & 0xffffff;
             tableLength = (wc - 1) * 8;
@@ -1354,15 +1342,12 @@ static void printSymbols(Module *module, Symbol *symbol) {
     printSymbols(module, symbol->right);
 }
 
-static int processBRT(Dataset *ds, u64 hdr, int tableLength) {
+static int processBRT(u64 hdr, u8 *table, int tableLength) {
     u32 baseAddress;
     u32 bitAddress;
     Block *block;
     int blockIndex;
-    u64 field;
     int fieldLength;
-    u32 imageBytes;
-    int imageOffset;
     bool isParcelRelocation;
     u32 parcelAddress;
     int shiftBias;
@@ -1374,14 +1359,15 @@ static int processBRT(Dataset *ds, u64 hdr, int tableLength) {
     if (targetBlock == NULL) {
         eprintf("Failed to find block %d referenced by BRT of module %s", blockIndex, currentModule->id);
         errorCount += 1;
-        return skipBytes(ds, tableLength);
+        return 0;
     }
     if (isSet(hdr, 28)) {
         //
         //  Process extended format table
         //
         while (tableLength > 0) {
-            if (readWord(ds, &word)) return -1;
+            word = getWord(table);
+            table += 8;
             tableLength -= 8;
             blockIndex = (word >> 38) & 0x7f;
             fieldLength = (word >> 32) & 0x3f;
@@ -1396,9 +1382,7 @@ static int processBRT(Dataset *ds, u64 hdr, int tableLength) {
                 continue;
             }
             bitAddress += targetBlock->baseAddress << 6;
-            field = getField(image, bitAddress, fieldLength);
-            field += isParcelRelocation ? block->baseAddress << 2 : block->baseAddress;
-            putField(image, bitAddress, fieldLength, field);
+            relocateField(bitAddress, fieldLength, isParcelRelocation ? block->baseAddress << 2 : block->baseAddress);
         }
     }
     else {
@@ -1407,7 +1391,8 @@ static int processBRT(Dataset *ds, u64 hdr, int tableLength) {
         //
         baseAddress = targetBlock->baseAddress;
         while (tableLength > 0) {
-            if (readWord(ds, &word)) return -1;
+            word = getWord(table);
+            table += 8;
             tableLength -= 8;
             for (shiftBias = 32; shiftBias >= 0; shiftBias -= 32) {
                 blockIndex = (word >> (25 + shiftBias)) & 0x7f;
@@ -1421,28 +1406,75 @@ static int processBRT(Dataset *ds, u64 hdr, int tableLength) {
                     errorCount += 1;
                     continue;
                 }
+                //
+                //  The field is the 32 bits beginning at the parcel address
+                //
                 parcelAddress += baseAddress << 2;
-                imageOffset = parcelAddress * 2;
-                imageBytes = (image[imageOffset  ] << 24)
-                           | (image[imageOffset+1] << 16)
-                           | (image[imageOffset+2] <<  8)
-                           |  image[imageOffset+3];
-                if (isParcelRelocation) {
-                    imageBytes += block->baseAddress << 2;
-                }
-                else {
-                    imageBytes += block->baseAddress;
-                }
-                image[imageOffset  ] =  imageBytes >> 24;
-                image[imageOffset+1] = (imageBytes >> 16) & 0xff;
-                image[imageOffset+2] = (imageBytes >>  8) & 0xff;
-                image[imageOffset+3] =  imageBytes        & 0xff;
+                relocateField((parcelAddress << 4) + 31, 32,
+                              isParcelRelocation ? block->baseAddress << 2 : block->baseAddress);
             }
         }
     }
     return 0;
 }
 
+static int processDFT(u8 *table, int tableLength, char *sourcePath, bool isDirectory) {
+    int base;
+    int blockWordCount;
+    u8 *entries;
+    int entryWordCount;
+    int externWordCount;
+    Module *module;
+    int n;
+    int offset;
+    u64 word;
+
+    for (base = 0; base < tableLength; base += n) {
+        word = getWord(table + base);
+        n = ((word >> 39) & 0x1fffff) * 8;
+        externWordCount = (word >> 24) & 0x7fff;
+        entryWordCount  = (word >> 9) & 0x7fff;
+        blockWordCount  = word & 0x1ff;
+        if (n < (blockWordCount + entryWordCount + externWordCount + 3) * 8 || base + n > tableLength) {
+            eprintf("Invalid DFT in %s", sourcePath);
+            return -1;
+        }
+        if (entryWordCount > 0 || externWordCount > 0) {
+            module = (Module *)allocate(sizeof(Module));
+            module->libraryPath = sourcePath;
+            offset = base + 8;
+            memcpy(module->id, table + offset, 8);
+            offset += 8;
+            if (isDirectory) module->position = (long)(getWord(table + offset) & 0x1ffffffff) * 8;
+            offset += (blockWordCount * 8) + 8;
+            if (entryWordCount > 0) {
+                module->entryCount = entryWordCount;
+                entries = (u8 *)allocate(entryWordCount * 8);
+                module->entryTable = entries;
+                memcpy(entries, table + offset, entryWordCount * 8);
+                offset += entryWordCount * 8;
+            }
+            if (externWordCount > 0) {
+                module->externalRefCount = externWordCount;
+                entries = (u8 *)allocate(externWordCount * 8);
+                module->externalRefTable = entries;
+                memcpy(entries, table + offset, externWordCount * 8);
+            }
+#if DEBUG
+            eprintf("Collect %d entry names and %d external reference names from module %.8s of library %s", entryWordCount, externWordCount, module->id, sourcePath);
+#endif
+            if (addLibraryModule(module) == FALSE) {
+                eprintf("WARNING: Duplicate module name %.8s in library %s", module->id, sourcePath);
+            }
+            else {
+                addEntryPoints(module);
+            }
+        }
+    }
+
+    return 0;
+}
+
 static int processPDT(Dataset *ds, u8 *moduleId, u64 hdr, u8 *table, int tableLength) {
     Block *block;
     int blockIndex;
@@ -1468,8 +1500,11 @@ static int processPDT(Dataset *ds, u8 *moduleId, u64 hdr, u8 *table, int tableLe
     hdrLen = getWord(table) & 0x3fff;
     offset = hdrLen * 8;
     //
-    //  Build chain of blocks, if the module has any.
+    //  Build chain of blocks, if the module has any, and a vector of them
+    //  in the same order for findBlock. Blocks of length zero are left out
+    //  of both.
     //
+    if (blockWordCount > 0) currentModule->blocks = (Block **)allocate((blockWordCount / 2) * sizeof(Block *));
     idx = 0;
     for (i = 0; i < blockWordCount; i += 2) {
         block = (Block *)allocate(sizeof(Block));
@@ -1507,6 +1542,7 @@ static int processPDT(Dataset *ds, u8 *moduleId, u64 hdr, u8 *table, int tableLe
             block->isExtMem = ((word >> 48) & 0x3f) == 2;
         }
         addBlock(currentModule, block);
+        currentModule->blocks[currentModule->blockCount++] = block;
     }
     //
     //  Process entry point definitions, if any
@@ -1571,53 +1607,86 @@ static int processPDT(Dataset *ds, u8 *moduleId, u64 hdr, u8 *table, int tableLe
     return 0;
 }
 
-static int processTXT(Dataset *ds, u64 hdr, int tableLength) {
+static int processTables(Module *module) {
+    u64 hdr;
+    int offset;
+    int status;
+    int tableLength;
+    u8 tableType;
+
+    currentModule = module;
+    offset = 0;
+    while (offset < module->tableCacheLength) {
+        hdr = getWord(module->tableCache + offset);
+        offset += 8;
+        tableType = hdr >> 60;
+        tableLength = (((hdr >> 36) & 0xffffff) - 1) * 8;
+        switch (tableType) {
+        case LDR_TT_XRT:
+            status = processXRT(hdr, module->tableCache + offset, tableLength);
+            break;
+        case LDR_TT_BRT:
+            status = processBRT(hdr, module->tableCache + offset, tableLength);
+            break;
+        default: // LDR_TT_TXT
+            status = processTXT(hdr, module->tableCache + offset, tableLength);
+            break;
+        }
+        if (status == -1) return -1;
+        offset += tableLength;
+    }
+    free(module->tableCache);
+    module->tableCache = NULL;
+    module->tableCacheLength = module->tableCacheSize = 0;
+
+    return 0;
+}
+
+static int processTXT(u64 hdr, u8 *table, int tableLength) {
     Block *block;
     int blockIndex;
-    int imageOffset;
+    int i;
     u32 loadAddress;
-    int n;
 
     blockIndex = (hdr >> 25) & 0x7f;
     loadAddress = hdr & 0xffffff;
     block = findBlock(currentModule, blockIndex);
     if (block != NULL) {
         loadAddress += block->baseAddress;
-        imageOffset = loadAddress * 8;
-        if (imageOffset + tableLength > imageSize) {
+        if (loadAddress + (tableLength / 8) > imageSize) {
             eprintf("TXT of module %s exceeds image size (load address %o, length %d)",
                 currentModule->id, loadAddress, tableLength);
             errorCount += 1;
-            return skipBytes(ds, tableLength);
+            return 0;
         }
 #if DEBUG
-        eprintf("Load block %d of module %.8s to address %o%c", blockIndex, currentModule->id, imageOffset >> 3, 'a' + ((imageOffset >> 1) & 3));
+        eprintf("Load block %d of module %.8s to address %oa", blockIndex, currentModule->id, loadAddress);
 #endif
-        n = cosDsRead(ds, image + imageOffset, tableLength);
-        return (n == tableLength) ? 0 : -1;
+        for (i = 0; i < tableLength; i += 8) image[loadAddress++] = getWord(table + i);
     }
     else {
         eprintf("Failed to find block %d referenced by TXT of module %.8s", blockIndex, currentModule->id);
         errorCount += 1;
-        return skipBytes(ds, tableLength);
     }
+    return 0;
 }
 
-static int processXRT(Dataset *ds, u64 hdr, int tableLength) {
+static int processXRT(u64 hdr, u8 *table, int tableLength) {
     u32 bitAddress;
     Block *block;
     int blockIndex;
     int extIndex;
-    u64 field;
     u8 fieldLength;
     u8 *id;
+    u64 increment;
     bool isParcelRelocation;
     u32 parcelAddress;
     Symbol *symbol;
     u64 word;
 
     while (tableLength > 0) {
-        if (readWord(ds, &word)) return -1;
+        word = getWord(table);
+        table += 8;
         tableLength -= 8;
         blockIndex = (word >> 51) & 0x7f;
         isParcelRelocation = isSet(word, 13);
@@ -1646,70 +1715,78 @@ static int processXRT(Dataset *ds, u64 hdr, int tableLength) {
             continue;
         }
         bitAddress += block->baseAddress << 6;
-        field = getField(image, bitAddress, fieldLength);
         if (isParcelRelocation) {
             if (symbol->isParcelAddress)
-                field += symbol->value;
+                increment = symbol->value;
             else
-                field += symbol->value << 2;
+                increment = symbol->value << 2;
         }
         else if (symbol->isParcelAddress) {
-            field += symbol->value >> 2;
+            increment = symbol->value >> 2;
         }
         else {
-            field += symbol->value;
+            increment = symbol->value;
         }
-        putField(image, bitAddress, fieldLength, field);
+        relocateField(bitAddress, fieldLength, increment);
     }
     return 0;
 }
 
-static void putField(u8 *bytes, u32 rightmostBit, u16 fieldLength, u64 field) {
-    u32 byteOffset;
+static void putWord(u8 *bytes, u64 word) {
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        *(bytes + i) = word & 0xff;
+        word >>= 8;
+    }
+}
+
+//
+//  Add an increment to a field of the image. Bit addresses number the bits
+//  of the image from the leftmost bit of word 0, and identify the rightmost
+//  bit of the field. A field may span two words.
+//
+static void relocateField(u32 rightmostBit, u16 fieldLength, u64 increment) {
+    u64 field;
+    u32 index;
     u64 mask;
     int shiftCount;
     u64 word;
 
-    mask = formMask(fieldLength);
-    field &= mask;
-    byteOffset = (rightmostBit >> 3) - 7;
-    if ((rightmostBit & 7) == 7) { /* byte-aligned */
-        word = (getWord(bytes + byteOffset) & ~mask) | field;
-        putWord(bytes + byteOffset, word);
+    index = rightmostBit >> 6;
+    shiftCount = 63 - (rightmostBit & 0x3f);
+    mask = (fieldLength < 64) ? ((u64)1 << fieldLength) - 1 : ~(u64)0;
+    if (fieldLength + shiftCount <= 64) {
+        //
+        //  The field lies within one word, as do all parcel address fields
+        //  that do not cross a word boundary, so the increment can be
+        //  added in place and the carry out of the field discarded.
+        //
+        word = image[index];
+        image[index] = (word & ~(mask << shiftCount)) | ((word + (increment << shiftCount)) & (mask << shiftCount));
     }
     else {
-        shiftCount = 7 - (rightmostBit & 7);
-        word = (getWord(bytes + byteOffset) & ~(mask << shiftCount)) | (field << shiftCount);
-        putWord(bytes + byteOffset, word);
-        if (fieldLength >= 56) {
-            byteOffset -= 1;
-            mask = formMask(shiftCount);
-            bytes[byteOffset] = (bytes[byteOffset] & ~mask) | (field >> (64 - shiftCount));
-        }
+        field = ((image[index - 1] << (64 - shiftCount)) | (image[index] >> shiftCount)) + increment;
+        field &= mask;
+        image[index] = (image[index] & ~(mask << shiftCount)) | (field << shiftCount);
+        image[index - 1] = (image[index - 1] & ~(mask >> (64 - shiftCount))) | (field >> (64 - shiftCount));
     }
 }
 
-static void putWord(u8 *bytes, u64 word) {
-    int i;
+static void resizeEntryIndex(void) {
+    EntryPoint *entryPoint;
+    EntryPoint **slot;
 
-    for (i = 7; i >= 0; i--) {
-        *(bytes + i) = word & 0xff;
-        word >>= 8;
+    if (entryPointIndex != NULL) free(entryPointIndex);
+    entryPointIndexSize = (entryPointIndexSize > 0) ? entryPointIndexSize * 2 : ENTRY_INDEX_SIZE;
+    entryPointIndex = (EntryPoint **)allocate(entryPointIndexSize * sizeof(EntryPoint *));
+    for (entryPoint = firstEntryPoint; entryPoint != NULL; entryPoint = entryPoint->next) {
+        slot = &entryPointIndex[hashEntryName(entryPoint->id) & (entryPointIndexSize - 1)];
+        entryPoint->nextInChain = *slot;
+        *slot = entryPoint;
     }
 }
 
-static int readWord(Dataset *ds, u64 *word) {
-    u8 buf[8];
-    int i;
-    int n;
-
-    n = cosDsRead(ds, buf, 8);
-    if (n != 8) return -1;
-    *word = 0;
-    for (i = 0; i < 8; i++) *word = (*word << 8) | buf[i];
-    return 0;
-}
-
 static bool resolveExternal(u8 *id) {
     int i;
     Module *module;
@@ -1932,6 +2009,8 @@ static int writeString(char *s, Dataset *ds) {
 }
 
 static int writeTXT(Dataset *ds) {
+    u32 address;
+    u8 buf[512*8];
     int byteCount;
     u64 word;
     u64 wordCount;
@@ -1940,10 +2019,20 @@ static int writeTXT(Dataset *ds) {
     //  Write header word
     //
     wordCount = blockLimit - 0200;
-    byteCount = wordCount * 8;
     word = ((u64)LDR_TT_TXT << 60) | ((wordCount + 1) << 36) | 0200;
     if (cosDsWriteWord(ds, word) == -1) return -1;
-    if (cosDsWrite(ds, image + (0200 * 8), byteCount) != byteCount) return -1;
+    //
+    //  Write the image, converting its words to big-endian byte order
+    //
+    byteCount = 0;
+    for (address = 0200; address < blockLimit; address++) {
+        putWord(buf + byteCount, image[address]);
+        byteCount += 8;
+        if (byteCount >= sizeof(buf) || address + 1 >= blockLimit) {
+            if (cosDsWrite(ds, buf, byteCount) != byteCount) return -1;
+            byteCount = 0;
+        }
+    }
 
     return 0;
 }
@@ -24,6 +24,7 @@
 **--------------------------------------------------------------------------
 */
 
+#define ENTRY_INDEX_SIZE         1024
 #define EXTERN_TABLE_INCREMENT   100
 #define FALSE                    0
 #define IMAGE_INCREMENT          4096
@@ -31,6 +32,7 @@
 #define MAX_LIBRARIES            64
 #define MAX_SOURCE_FILES         128
 #define RELOC_TABLE_INCREMENT    200
+#define TABLE_CACHE_INCREMENT    4096
 #define TRUE                     1
 
 #define isSet(word, bitnum) (((word) >> ((63-(bitnum)))) & 1)
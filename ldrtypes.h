@@ -59,17 +59,30 @@ typedef struct module {
     struct module *right;
     u8 id[8];
     char *libraryPath;
+    long position;
     Block *firstBlock;
     Block *lastBlock;
+    Block **blocks;
+    int blockCount;
     int entryCount;
     u8 *entryTable;
     int externalRefCount;
     u8 *externalRefTable;
+    u8 *tableCache;
+    int tableCacheLength;
+    int tableCacheSize;
     char *comment;
     bool doLoad;
     bool isLoaded;
 } Module;
 
+typedef struct entryPoint {
+    struct entryPoint *next;
+    struct entryPoint *nextInChain;
+    u8 *id;
+    Module *module;
+} EntryPoint;
+
 typedef struct symbol {
     struct symbol *left;
     struct symbol *right;
@@ -48,6 +48,7 @@ static void appendObjectFile(Dataset *ods, Dataset *ids, char *argv[], char *sou
 static void calculateModuleName(char *path, char *name);
 static int copyBytes(Dataset *ods, Dataset *ids, int count, char *sourcePath);
 static Module *findModule(char *id);
+static u64 getModuleLocation(Module *module);
 static char *getTableType(u8 type);
 static u64 getWord(u8 *bytes);
 static bool isLibrary(Dataset *ds);
@@ -61,6 +62,8 @@ static int skipBytes(Dataset *ds, int count);
 static void usage(void);
 static int writeBytes(Dataset *ds, u8 *buf, int len);
 static int writeDFT(Dataset *ds, Module *module);
+static int writeDirectory(Dataset *ds);
+static int writeDirectoryEntry(Dataset *ds, Module *module);
 static int writeEOR(Dataset *ds);
 static int writeName(char *name, Dataset *ds);
 static int writeNames(Symbol *symbol, Dataset *ds);
@@ -221,6 +224,7 @@ int main(int argc, char *argv[]) {
 #else
         if (cosDsWriteEOR(outputFile) == -1
             || cosDsWriteEOF(outputFile) == -1
+            || writeDirectory(outputFile) == -1
             || cosDsWriteEOD(outputFile) == -1
             || cosDsClose(outputFile) == -1) {
             eprintf("Failed to write output file %s", tempPath);
@@ -533,9 +537,19 @@ static void appendLibrary(Dataset *ods, Dataset *ids, char *argv[], char *source
             free(table);
             break;
         case LDR_TT_DFT:
+            //
+            //  Replace the module's location with its location in the
+            //  output file.
+            //
+            if (cosDsRead(ids, buf + 16, 8) != 8) {
+                eprintf("Failed to read DFT from %s", sourcePath);
+                exit(1);
+            }
+            if (ods != NULL) module->position = cosDsTell(ods);
             if (writeWord(ods, hdr) == -1
                 || writeBytes(ods, buf, 16) == -1
-                || copyBytes(ods, ids, tableLength, sourcePath) == -1) {
+                || writeWord(ods, getModuleLocation(module)) == -1
+                || copyBytes(ods, ids, tableLength - 8, sourcePath) == -1) {
                 exit(1);
             }
             break;
@@ -721,6 +735,14 @@ static Module *findModule(char *id) {
     return current;
 }
 
+//
+//  The location of a module is the word address of its DFT within the
+//  library, including control words. It is 0 when the location is unknown.
+//
+static u64 getModuleLocation(Module *module) {
+    return (module->position > 0) ? (module->position / 8) & 0x1ffffffff : 0;
+}
+
 static char *getTableType(u8 type) {
     switch (type) {
     case LDR_TT_PWT: return "PWT";
@@ -957,10 +979,8 @@ static void usage(void) {
 }
 
 static int writeDFT(Dataset *ods, Module *module) {
-    u64 fwa;
     u64 hdr;
     u64 dftLen;
-    u64 word;
 
     if (ods == NULL) return 0;
 
@@ -971,16 +991,59 @@ static int writeDFT(Dataset *ods, Module *module) {
          | ('D' << 16)
          | ('0' << 8)
          | '1';
+    module->position = cosDsTell(ods);
+    if (writeWord(ods, hdr) == -1
+        || writeDirectoryEntry(ods, module) == -1)
+        return -1;
+
+    return 0;
+}
+
+//
+//  The directory is a DFT, with an entry for each module in the library,
+//  written as a separate file following the file containing the modules.
+//  The location in each entry enables a loader to read the directory
+//  instead of the entire library, and then seek directly to the modules
+//  it needs. Loaders that do not use the directory stop reading at the end
+//  of the first file.
+//
+static int writeDirectory(Dataset *ods) {
+    u64 hdr;
+    u64 dftLen;
+    Module *module;
+
+    if (ods == NULL || modules == NULL) return 0;
+
+    dftLen = 1;
+    for (module = modules; module != NULL; module = module->next) {
+        if (module->position < 0) return 0;
+        dftLen += module->blockCount + module->entryCount + module->externalCount + 3;
+    }
+    hdr  = ((u64)LDR_TT_DFT << 60)
+         | (dftLen << 24)
+         | ('D' << 16)
+         | ('0' << 8)
+         | '1';
+    if (writeWord(ods, hdr) == -1) return -1;
+    for (module = modules; module != NULL; module = module->next) {
+        if (writeDirectoryEntry(ods, module) == -1) return -1;
+    }
+    if (writeEOR(ods) == -1 || cosDsWriteEOF(ods) == -1) return -1;
+
+    return 0;
+}
+
+static int writeDirectoryEntry(Dataset *ods, Module *module) {
+    u64 word;
+
     word = ((u64)1 << 60)
          | ((u64)(module->blockCount + module->entryCount + module->externalCount + 3) << 39)
          | (module->externalCount << 24)
          | (module->entryCount    <<  9)
          | module->blockCount;
-    fwa = 0; // TODO: set FWA of module
-    if (writeWord(ods, hdr) == -1
-        || writeWord(ods, word) == -1
+    if (writeWord(ods, word) == -1
         || writeName(module->id, ods) == -1
-        || writeWord(ods, word) == -1
+        || writeWord(ods, getModuleLocation(module)) == -1
         || writeNames(module->blocks, ods) == -1
         || writeNames(module->entries, ods) == -1
         || writeNames(module->externals, ods) == -1)
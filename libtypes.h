@@ -36,6 +36,7 @@ typedef struct module {
     struct module *right;
     struct module *next;
     char *id;
+    long position;
     int blockCount;
     Symbol *blocks;
     int entryCount;
@@ -7,6 +7,11 @@
 **  Description:
 **      This file provides functions for generating the output listing.
 **
+**      The listing may also be written compressed (-L), as a journal of
+**      formatted listing lines in which runs of blanks are encoded in single
+**      bytes. A compressed listing is about a third of the size of the
+**      listing, and listRender (-R) expands it.
+**
 **  Licensed under the Apache License, Version 2.0 (the "License");
 **  you may not use this file except in compliance with the License.
 **  You may obtain a copy of the License at
@@ -22,18 +27,26 @@
 **--------------------------------------------------------------------------
 */
 
+#include <stdlib.h>
 #include <string.h>
 #include "calproto.h"
 #include "caltypes.h"
+#include "services.h"
 
+static int compareSymbols(const void *s1, const void *s2);
 static bool isListSuppressed(void);
 static void listPageHeader(Section *section);
+static int  listPageStart(int n);
+static void listPuts(char *s);
 static void listQualifiers(Qualifier *qualifier);
-static void listSymbols(Symbol *symbol);
+static void listSymbol(Symbol *symbol);
+static void listSymbols(Qualifier *qualifier);
+static void listWrite(char *s, FILE *fp);
 static void resetHeaderLine(void);
 static void resetListingLine(void);
 
 #define LINES_PER_PAGE      55
+#define LISTING_JOURNAL_MAGIC "kCALLSJ"
 #define LISTING_LINE_LENGTH 132
 #define COL_CAL_VERSION     76
 #define COL_CPU_TYPE        66
@@ -50,18 +63,28 @@ static void resetListingLine(void);
 #define COL_TIME            105
 #define COL_TITLE           1
 
+static FILE *captureFile = NULL;
 static char *cpuType = "Cray X-MP";
 static Section dummySection;
 static char headerLine[LISTING_LINE_LENGTH+2];
+static bool isJournal = FALSE;
 static int  lineNumber = 0;
 static char listingLine[LISTING_LINE_LENGTH+2];
 static char parcelIndicator[4] = {'a', 'b', 'c', 'd'};
 
+static int compareSymbols(const void *s1, const void *s2) {
+    return strcasecmp((*(Symbol **)s1)->id, (*(Symbol **)s2)->id);
+}
+
 static bool isListSuppressed(void) {
     if (pass == 1 || listingFile == NULL) return TRUE;
     return (currentListControl & listControlMask) != listControlMask && hasErrorRegistrations() == FALSE;
 }
 
+void listCapture(FILE *fp) {
+    captureFile = fp;
+}
+
 void listClearSource(void) {
     char *cp;
     char *limit;
@@ -199,7 +222,7 @@ void listFlush(Section *section) {
     if (pass == 1) return;
     if (isListSuppressed() == FALSE) {
         if ((lineNumber % LINES_PER_PAGE) == 0) listPageHeader(section);
-        fputs(listingLine, listingFile);
+        listPuts(listingLine);
         lineNumber += 1;
     }
     resetListingLine();
@@ -212,6 +235,18 @@ void listInit(void) {
     resetListingLine();
 }
 
+/*
+**  listJournal - select whether the listing is written as a journal
+*/
+void listJournal(bool isEnabled) {
+    isJournal = isEnabled;
+    if (isJournal) fwrite(LISTING_JOURNAL_MAGIC, 1, sizeof(LISTING_JOURNAL_MAGIC), listingFile);
+}
+
+int listLineNumber(void) {
+    return lineNumber;
+}
+
 void listLocation(u32 location) {
     int i;
     char *cp;
@@ -229,6 +264,40 @@ void listLocation(u32 location) {
     }
 }
 
+void listMerge(FILE *from, FILE *to, int startLineNumber, int endLineNumber, bool isRestamped) {
+    char buf[LISTING_LINE_LENGTH+2];
+    bool isLineStart;
+    int n;
+    int pageOffset;
+
+    //
+    //  The listing in "from" was produced by a separate assembly that began
+    //  with the line number startLineNumber and ended with endLineNumber.
+    //  Pass 2 begins on a new page, so shift the assembly's page numbers by
+    //  the number of whole pages listed since it began. A listing saved by
+    //  an earlier run also receives the current date and time.
+    //
+    lineNumber = listPageStart(lineNumber);
+    startLineNumber = listPageStart(startLineNumber);
+    pageOffset = (lineNumber - startLineNumber) / LINES_PER_PAGE;
+    isLineStart = TRUE;
+    while (fgets(buf, sizeof(buf), from) != NULL) {
+        n = strlen(buf);
+        if (isLineStart && buf[0] == '1' && n > COL_PAGE + 5
+            && strncmp(&buf[COL_PAGE], "PAGE ", 5) == 0) {
+            if (isRestamped) {
+                memcpy(&buf[COL_DATE], currentDate, strlen(currentDate));
+                memcpy(&buf[COL_TIME], currentTime, strlen(currentTime));
+            }
+            sprintf(&buf[COL_PAGE + 5], "%4d\n", atoi(&buf[COL_PAGE + 5]) + pageOffset);
+            n = strlen(buf);
+        }
+        listWrite(buf, to);
+        isLineStart = buf[n - 1] == '\n';
+    }
+    lineNumber += endLineNumber - startLineNumber;
+}
+
 static void listPageHeader(Section *section) {
     char buf[20];
     char *cp;
@@ -269,7 +338,7 @@ static void listPageHeader(Section *section) {
         while (*cp != '\0') *hp++ = *cp++;
         *hp++ = '\n';
         *hp   = '\0';
-        fputs(headerLine, listingFile);
+        listPuts(headerLine);
     
         resetHeaderLine();
         headerLine[0] = ' ';
@@ -291,22 +360,60 @@ static void listPageHeader(Section *section) {
         while (*cp != '\0' && hp < limit) *hp++ = *cp++;
         *hp++ = '\n';
         *hp   = '\0';
-        fputs(headerLine, listingFile);
-        fputs("\n\n", listingFile);
+        listPuts(headerLine);
+        listPuts("\n\n");
     }
     lineNumber += 4;
 }
 
+static int listPageStart(int n) {
+    return ((n + LINES_PER_PAGE - 1) / LINES_PER_PAGE) * LINES_PER_PAGE;
+}
+
+static void listPuts(char *s) {
+    listWrite(s, listingFile);
+    if (captureFile != NULL) fputs(s, captureFile);
+}
+
 static void listQualifiers(Qualifier *qualifier) {
     if (qualifier != NULL) {
         listQualifiers(qualifier->left);
         currentQualifier = qualifier;
         listEject();
-        listSymbols(qualifier->symbols);
+        listSymbols(qualifier);
         listQualifiers(qualifier->right);
     }
 }
 
+/*
+**  listRender - expand a compressed listing
+*/
+int listRender(FILE *from, FILE *to) {
+    char buf[128];
+    int c;
+    char magic[sizeof(LISTING_JOURNAL_MAGIC)];
+    int n;
+
+    if (fread(magic, 1, sizeof(magic), from) != sizeof(magic)
+        || memcmp(magic, LISTING_JOURNAL_MAGIC, sizeof(magic)) != 0) return -1;
+    memset(buf, ' ', sizeof(buf));
+    while ((c = getc(from)) != EOF) {
+        if (c == 0) {
+            putc('\n', to);
+        }
+        else if ((c & 0x80) != 0) {
+            fwrite(buf, 1, c & 0x7f, to);
+        }
+        else {
+            n = fread(buf, 1, c, from);
+            fwrite(buf, 1, n, to);
+            memset(buf, ' ', n);
+            if (n < c) return -1;
+        }
+    }
+    return 0;
+}
+
 void listSource(void) {
     char *cp;
     char *limit;
@@ -319,48 +426,59 @@ void listSource(void) {
     while (*sp != '\0' && cp < limit) *cp++ = *sp++;
 }
 
-static void listSymbols(Symbol *symbol) {
+static void listSymbol(Symbol *symbol) {
     int col;
 
-    if (symbol != NULL) {
-        listSymbols(symbol->left);
-        if ((symbol->value.attributes & (SYM_COUNTER|SYM_UNDEFINED)) == 0) {
-            sprintf(listingLine, " %-8s ", symbol->id);
-            col = 10;
-            if (symbol->value.section != NULL) {
-                sprintf(&listingLine[col], " %-8s ", symbol->value.section->id);
-            }
-            else {
-                memset(&listingLine[col], ' ', 10);
-            }
-            col += 10;
-            listingLine[col++] = ((symbol->value.attributes & SYM_REDEFINABLE) != 0) ? 'R' : ' ';
-            if ((symbol->value.attributes & SYM_WORD_ADDRESS) != 0)
-                listingLine[col++] = 'W';
-            else if ((symbol->value.attributes & SYM_PARCEL_ADDRESS) != 0)
-                listingLine[col++] = 'P';
-            else if ((symbol->value.attributes & SYM_BYTE_ADDRESS) != 0)
-                listingLine[col++] = 'B';
-            else
-                listingLine[col++] = 'V';
-            if ((symbol->value.attributes & SYM_EXTERNAL) != 0)
-                listingLine[col++] = 'X';
-            else if ((symbol->value.attributes & SYM_RELOCATABLE) != 0)
-                listingLine[col++] = '+';
-            else if ((symbol->value.attributes & SYM_IMMOBILE) != 0)
-                listingLine[col++] = 'I';
-            else
-                listingLine[col++] = ' ';
-            listingLine[col++] = isCommonSection(symbol->value.section) ? 'C' : ' ';
-            col += 2;
-            if ((symbol->value.attributes & SYM_PARCEL_ADDRESS) != 0)
-                sprintf(&listingLine[col], "%lo%c\n", symbol->value.value.intValue >> 2, parcelIndicator[symbol->value.value.intValue & 0x03]);
-            else
-                sprintf(&listingLine[col], "%lo\n", symbol->value.value.intValue);
-            listFlush(&dummySection);
+    if ((symbol->value.attributes & (SYM_COUNTER|SYM_UNDEFINED)) == 0) {
+        sprintf(listingLine, " %-8s ", symbol->id);
+        col = 10;
+        if (symbol->value.section != NULL) {
+            sprintf(&listingLine[col], " %-8s ", symbol->value.section->id);
+        }
+        else {
+            memset(&listingLine[col], ' ', 10);
         }
-        listSymbols(symbol->right);
+        col += 10;
+        listingLine[col++] = ((symbol->value.attributes & SYM_REDEFINABLE) != 0) ? 'R' : ' ';
+        if ((symbol->value.attributes & SYM_WORD_ADDRESS) != 0)
+            listingLine[col++] = 'W';
+        else if ((symbol->value.attributes & SYM_PARCEL_ADDRESS) != 0)
+            listingLine[col++] = 'P';
+        else if ((symbol->value.attributes & SYM_BYTE_ADDRESS) != 0)
+            listingLine[col++] = 'B';
+        else
+            listingLine[col++] = 'V';
+        if ((symbol->value.attributes & SYM_EXTERNAL) != 0)
+            listingLine[col++] = 'X';
+        else if ((symbol->value.attributes & SYM_RELOCATABLE) != 0)
+            listingLine[col++] = '+';
+        else if ((symbol->value.attributes & SYM_IMMOBILE) != 0)
+            listingLine[col++] = 'I';
+        else
+            listingLine[col++] = ' ';
+        listingLine[col++] = isCommonSection(symbol->value.section) ? 'C' : ' ';
+        col += 2;
+        if ((symbol->value.attributes & SYM_PARCEL_ADDRESS) != 0)
+            sprintf(&listingLine[col], "%lo%c\n", symbol->value.value.intValue >> 2, parcelIndicator[symbol->value.value.intValue & 0x03]);
+        else
+            sprintf(&listingLine[col], "%lo\n", symbol->value.value.intValue);
+        listFlush(&dummySection);
+    }
+}
+
+static void listSymbols(Qualifier *qualifier) {
+    int i;
+    Symbol *symbol;
+    Symbol **symbols;
+
+    if (qualifier->symbolCount < 1) return;
+    symbols = (Symbol **)allocate(qualifier->symbolCount * sizeof(Symbol *));
+    for (i = 0, symbol = qualifier->firstSymbol; symbol != NULL; symbol = symbol->nextInQualifier) {
+        symbols[i++] = symbol;
     }
+    qsort(symbols, qualifier->symbolCount, sizeof(Symbol *), compareSymbols);
+    for (i = 0; i < qualifier->symbolCount; i++) listSymbol(symbols[i]);
+    free(symbols);
 }
 
 void listSymbolTable() {
@@ -415,6 +533,45 @@ void listWord(u64 bits, u16 attributes) {
 
 }
 
+/*
+ *  In a journal, each line ends with a 0 byte, a byte of 0x80 + n stands for
+ *  n blanks, and a byte of n (less than 0x80) precedes n characters of text.
+ *  Single blanks are kept within text.
+ */
+static void listWrite(char *s, FILE *fp) {
+    u8 buf[LISTING_LINE_LENGTH*2];
+    int i;
+    int n;
+
+    if (isJournal == FALSE) {
+        fputs(s, fp);
+        return;
+    }
+    i = 0;
+    while (*s != '\0') {
+        if (i > sizeof(buf) - 130) {
+            fwrite(buf, 1, i, fp);
+            i = 0;
+        }
+        if (*s == '\n') {
+            buf[i++] = 0;
+            s += 1;
+        }
+        else if (*s == ' ' && *(s + 1) == ' ') {
+            for (n = 0; *s == ' ' && n < 0x7f; n++) s += 1;
+            buf[i++] = 0x80 | n;
+        }
+        else {
+            for (n = 0; s[n] != '\0' && s[n] != '\n' && (s[n] != ' ' || s[n + 1] != ' ') && n < 0x7f; n++)
+                buf[i + 1 + n] = s[n];
+            buf[i] = n;
+            i += n + 1;
+            s += n;
+        }
+    }
+    fwrite(buf, 1, i, fp);
+}
+
 static void resetHeaderLine(void) {
     memset(headerLine, ' ', LISTING_LINE_LENGTH);
     headerLine[LISTING_LINE_LENGTH]   = '\n';
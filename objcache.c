@@ -0,0 +1,352 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright 2021 Kevin E. Jordan
+**
+**  Name: objcache.c
+**
+**  Description:
+**      This file provides functions that save the object records and listing
+**      produced by assembling a source file to a cache directory (-c), and
+**      that reuse them on subsequent runs, so that unchanged source files
+**      need not be reassembled.
+**
+**  Licensed under the Apache License, Version 2.0 (the "License");
+**  you may not use this file except in compliance with the License.
+**  You may obtain a copy of the License at
+**
+**      http://www.apache.org/licenses/LICENSE-2.0
+**
+**  Unless required by applicable law or agreed to in writing, software
+**  distributed under the License is distributed on an "AS IS" BASIS,
+**  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**  See the License for the specific language governing permissions and
+**  limitations under the License.
+**
+**--------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calconst.h"
+#include "calproto.h"
+#include "caltypes.h"
+#include "fnv.h"
+#include "services.h"
+
+#if defined(__cos)
+
+/*
+ *  Object caching is not supported on COS itself.
+ */
+void addObjectCacheText(void) {
+}
+
+bool loadObjectCache(char *ident) {
+    return FALSE;
+}
+
+void saveObjectCache(void) {
+}
+
+#else
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define OBJECT_CACHE_INCREMENT  4096
+#define OBJECT_CACHE_MAGIC      "kCALOBC"
+#define OBJECT_CACHE_NULL       0xffffffff
+#define OBJECT_CACHE_VERSION    1
+
+typedef struct keyBuffer {
+    u8 *data;
+    u32 size;
+    u32 length;
+} KeyBuffer;
+
+static void getCachePath(char *path, char *suffix);
+static bool hashFile(char *path, u32 *length, u32 *hash);
+static void makeKey(char *ident);
+static void putBytes(u8 *bytes, u32 len);
+static void putString(char *s);
+static void putU32(u32 value);
+static bool readU32(FILE *fp, u32 *value);
+static bool writeObjectDataset(char *path);
+static bool writeU32(FILE *fp, u32 value);
+
+static FILE      *captureFile = NULL;
+static char      capturePath[MAX_FILE_PATH_LENGTH+32];
+static bool      isDirectoryChecked = FALSE;
+static bool      isTextTimed = FALSE;
+static KeyBuffer key;
+static int       startLineNumber;
+static Fnv32_t   textHash = FNV1_32A_INIT;
+
+/*
+**  addObjectCacheText - fold the current external text file into the key
+**                       of source files assembled after it
+**
+**  Definitions made by a text file that refers to the date or time micros
+**  differ on each run, so no source file assembled after it is saved.
+*/
+void addObjectCacheText(void) {
+    u32 length;
+
+    if (isTimeReferenced) isTextTimed = TRUE;
+    length = sourceBufferLength;
+    textHash = fnv32a((char *)&length, sizeof(length), textHash);
+    textHash = fnv32a(sourceBuffer, sourceBufferLength, textHash);
+}
+
+/*
+ *  Cache entries are named by the hash of their keys. The ".occ" file holds
+ *  the key, the listing line numbers, the size and hash of the ".obj" file,
+ *  and the listing. The ".obj" file holds the object records.
+ */
+static void getCachePath(char *path, char *suffix) {
+    sprintf(path, "%s/%08x%s", objectCacheDir, fnv32a((char *)key.data, key.length, FNV1_32A_INIT), suffix);
+}
+
+static bool hashFile(char *path, u32 *length, u32 *hash) {
+    char buf[OBJECT_CACHE_INCREMENT];
+    FILE *fp;
+    int n;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) return FALSE;
+    *length = 0;
+    *hash = FNV1_32A_INIT;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+        *length += n;
+        *hash = fnv32a(buf, n, *hash);
+    }
+    fclose(fp);
+    return TRUE;
+}
+
+/*
+**  loadObjectCache - write the listing and object records of the current
+**                    source file from its cache entry, if there is one
+**
+**  When there is no cache entry, the listing produced by the assembly that
+**  follows is captured so that saveObjectCache can create one.
+*/
+bool loadObjectCache(char *ident) {
+    char cachePath[MAX_FILE_PATH_LENGTH+16];
+    u8 *data;
+    Dataset *ds;
+    u32 endLine;
+    FILE *fp;
+    u32 hash;
+    u32 length;
+    u32 objectHash;
+    u32 objectLength;
+    char objectPath[MAX_FILE_PATH_LENGTH+16];
+    u32 startLine;
+
+    key.length = 0;
+    isTimeReferenced = FALSE;
+    if (objectCacheDir == NULL) return FALSE;
+    if (isDirectoryChecked == FALSE) {
+        mkdir(objectCacheDir, 0755);
+        isDirectoryChecked = TRUE;
+    }
+    makeKey(ident);
+    getCachePath(cachePath, ".occ");
+    getCachePath(objectPath, ".obj");
+    fp = fopen(cachePath, "rb");
+    if (fp != NULL) {
+        data = (u8 *)allocate(key.length);
+        if (fread(data, 1, key.length, fp) == key.length
+            && memcmp(data, key.data, key.length) == 0
+            && readU32(fp, &startLine) && readU32(fp, &endLine)
+            && readU32(fp, &objectLength) && readU32(fp, &objectHash)
+            && (objectFile == NULL
+                || (hashFile(objectPath, &length, &hash) && length == objectLength && hash == objectHash))) {
+            free(data);
+            if (listingFile != NULL) listMerge(fp, listingFile, startLine, endLine, TRUE);
+            fclose(fp);
+            if (objectFile != NULL) {
+                ds = cosDsOpen(objectPath);
+                if (ds == NULL || cosDsCopyRecords(ds, objectFile) == -1) {
+                    eprintf("Failed to copy cached object records from %s", objectPath);
+                    exit(1);
+                }
+                cosDsClose(ds);
+            }
+            key.length = 0;
+            objectCacheHits += 1;
+            return TRUE;
+        }
+        free(data);
+        fclose(fp);
+    }
+    //
+    //  The new entry is written to a temporary file that is renamed when it
+    //  is complete, so that concurrent assemblies never see a partially
+    //  written one. The listing line numbers and the size and hash of the
+    //  object records are filled in by saveObjectCache.
+    //
+    objectCacheMisses += 1;
+    sprintf(capturePath, "%s.%d", cachePath, (int)getpid());
+    captureFile = fopen(capturePath, "wb");
+    if (captureFile == NULL) {
+        key.length = 0;
+        return FALSE;
+    }
+    if (fwrite(key.data, 1, key.length, captureFile) != key.length
+        || writeU32(captureFile, 0) == FALSE || writeU32(captureFile, 0) == FALSE
+        || writeU32(captureFile, 0) == FALSE || writeU32(captureFile, 0) == FALSE) {
+        fclose(captureFile);
+        unlink(capturePath);
+        captureFile = NULL;
+        key.length = 0;
+        return FALSE;
+    }
+    listCapture(captureFile);
+    startLineNumber = listLineNumber();
+    return FALSE;
+}
+
+/*
+**  makeKey - build the header that identifies the cache entry of the current
+**            source file
+**
+**  The header combines the cache format and assembler versions, the options
+**  that influence assembly, the outputs requested, a hash of the external
+**  text files assembled ahead of the source file, and the source itself.
+*/
+static void makeKey(char *ident) {
+    putBytes((u8 *)OBJECT_CACHE_MAGIC, sizeof(OBJECT_CACHE_MAGIC));
+    putU32(OBJECT_CACHE_VERSION);
+    putString(calVersion);
+    putU32((isFlexibleSyntax ? 1 : 0) | (isImplicitExternals ? 2 : 0) | (isSectionStackingEnabled ? 4 : 0)
+           | ((listingFile != NULL) ? 8 : 0) | ((objectFile != NULL) ? 16 : 0) | (isRelocationCompacted ? 32 : 0));
+    putString(ident);
+    putU32(textHash);
+    putU32(sourceBufferLength);
+    putBytes((u8 *)sourceBuffer, sourceBufferLength);
+}
+
+static void putBytes(u8 *bytes, u32 len) {
+    u32 newSize;
+
+    if (key.length + len > key.size) {
+        newSize = key.length + len + OBJECT_CACHE_INCREMENT;
+        key.data = (u8 *)reallocate(key.data, key.size, newSize);
+        key.size = newSize;
+    }
+    memcpy(key.data + key.length, bytes, len);
+    key.length += len;
+}
+
+static void putString(char *s) {
+    u32 len;
+
+    if (s == NULL) {
+        putU32(OBJECT_CACHE_NULL);
+    }
+    else {
+        len = strlen(s);
+        putU32(len);
+        putBytes((u8 *)s, len);
+    }
+}
+
+static void putU32(u32 value) {
+    u8 bytes[4];
+    int i;
+
+    for (i = 3; i >= 0; i--) {
+        bytes[i] = value & 0xff;
+        value >>= 8;
+    }
+    putBytes(bytes, 4);
+}
+
+static bool readU32(FILE *fp, u32 *value) {
+    u8 bytes[4];
+    int i;
+
+    if (fread(bytes, 1, 4, fp) != 4) return FALSE;
+    *value = 0;
+    for (i = 0; i < 4; i++) *value = (*value << 8) | bytes[i];
+    return TRUE;
+}
+
+/*
+**  saveObjectCache - create the cache entry of the current source file from
+**                    the results of assembling it
+**
+**  A source file that produces errors or warnings is never cached.
+*/
+void saveObjectCache(void) {
+    char cachePath[MAX_FILE_PATH_LENGTH+16];
+    bool isWritten;
+    u32 objectHash;
+    u32 objectLength;
+    char objectPath[MAX_FILE_PATH_LENGTH+16];
+    char tempPath[MAX_FILE_PATH_LENGTH+32];
+
+    if (key.length < 1) return;
+    listCapture(NULL);
+    getCachePath(cachePath, ".occ");
+    isWritten = FALSE;
+    //
+    //  A source that refers to the date or time micros, directly or through
+    //  a text file, assembles differently on each run, so it is never saved,
+    //  just as one with errors is not.
+    //
+    if (getErrorCount() == 0 && getWarningCount() == 0 && isTimeReferenced == FALSE && isTextTimed == FALSE) {
+        //
+        //  The ".occ" file is renamed last, and it records the size and
+        //  hash of the ".obj" file, so it never vouches for a different one.
+        //
+        getCachePath(objectPath, ".obj");
+        objectLength = objectHash = 0;
+        isWritten = TRUE;
+        if (objectFile != NULL) {
+            sprintf(tempPath, "%s.%d", objectPath, (int)getpid());
+            isWritten = writeObjectDataset(tempPath)
+                && hashFile(tempPath, &objectLength, &objectHash)
+                && rename(tempPath, objectPath) == 0;
+            if (isWritten == FALSE) unlink(tempPath);
+        }
+        isWritten = isWritten
+            && fseek(captureFile, key.length, SEEK_SET) == 0
+            && writeU32(captureFile, startLineNumber) && writeU32(captureFile, listLineNumber())
+            && writeU32(captureFile, objectLength) && writeU32(captureFile, objectHash);
+    }
+    if (fclose(captureFile) != 0 || isWritten == FALSE || rename(capturePath, cachePath) != 0) unlink(capturePath);
+    captureFile = NULL;
+    key.length = 0;
+}
+
+static bool writeObjectDataset(char *path) {
+    Dataset *ds;
+    Module *module;
+
+    ds = cosDsCreate(path);
+    if (ds == NULL) return FALSE;
+    for (module = firstModule; module != NULL; module = module->next) {
+        if (writeObjectRecord(module, ds) == -1) {
+            cosDsClose(ds);
+            return FALSE;
+        }
+    }
+    return cosDsWriteEOF(ds) != -1 && cosDsWriteEOD(ds) != -1 && cosDsClose(ds) != -1;
+}
+
+static bool writeU32(FILE *fp, u32 value) {
+    u8 bytes[4];
+    int i;
+
+    for (i = 3; i >= 0; i--) {
+        bytes[i] = value & 0xff;
+        value >>= 8;
+    }
+    return fwrite(bytes, 1, 4, fp) == 4;
+}
+
+#endif /* __cos */
@@ -7,6 +7,14 @@
 **  Description:
 **      This file privides functions for creating COS format object files.
 **
+**      Normally, the image of each object block is held in memory until
+**      the object record of its module is written. When object code is
+**      streamed (-B), only a window of each image is held in memory. The
+**      text, block relocation, and external reference tables of the part
+**      of an image that precedes its window are written to a spill dataset
+**      as the window moves forward, and the spill dataset is copied into
+**      the object record, following the PDT.
+**
 **  Licensed under the Apache License, Version 2.0 (the "License");
 **  you may not use this file except in compliance with the License.
 **  You may obtain a copy of the License at
@@ -22,7 +30,11 @@
 **--------------------------------------------------------------------------
 */
 
+#include <stdlib.h>
 #include <string.h>
+#if !defined(__cos)
+#include <unistd.h>
+#endif
 #include "calconst.h"
 #include "calproto.h"
 #include "caltypes.h"
@@ -33,14 +45,24 @@
 static void addExternalEntry(Section *section, Value *val, bool isParcelRelocation, u32 bitAddress, u8 fieldLength);
 static void addExtRelocationEntry(Section *section, Value *val, bool isParcelRelocation, u32 bitAddress, u8 fieldLength);
 static void addStdRelocationEntry(Section *section, Value *val, bool isParcelRelocation);
+static int compareExternalEntries(const void *e1, const void *e2);
+static int compareRelocationEntries(const void *e1, const void *e2);
+static void compactExternalTable(ObjectBlock *block);
+static void compactRelocationTable(ObjectBlock *block);
+static int copyObjectSpill(Module *module, Dataset *ds);
 static int countBlocks(Module *module);
 static int countEntries(Module *module);
 static int countExternals(Module *module);
 static u64 extractSubfield(u64 word, int fieldStartingBitPos, int len);
 static u64 getWord(Section *section, u32 parcelAddress);
+static void growImage(ObjectBlock *block, u32 limit);
+static u32 mapImage(Section *section, u32 addr, u32 limit);
+static u8 nextStringByte(char **s, int i, int n, int fillCount, u8 fillValue, JustifyType justification);
 static void putHalfWord(Section *section, u32 parcelAddress, u32 halfWord);
 static void putParcel(Section *section, u32 parcelAddress, u16 parcel);
 static void putWord(Section *section, u32 parcelAddress, u64 word);
+static void streamImage(Section *section, u32 base);
+static int streamRelocations(ObjectBlock *block, u32 limit, Dataset *ds);
 static int writeCommonBlockEntry(ObjectBlock *block, Dataset *ds);
 static int writeEntryEntries(Module *module, Dataset *ds);
 static int writeExtBRT(ObjectBlock *block, Dataset *ds);
@@ -52,7 +74,11 @@ static int writeStdBRT(ObjectBlock *block, Dataset *ds);
 static int writeString(char *s, Dataset *ds);
 static int writeTrailer(Module *module, Dataset *ds);
 static int writeTXT(ObjectBlock *block, u8 index, bool isAbsolute, Dataset *ds);
+static int writeTXTRange(ObjectBlock *block, u8 index, u32 loadAddress, u32 first, u32 limit, Dataset *ds);
 static int writeXRT(Module *module, Dataset *ds);
+static int writeXRTEntries(ObjectBlock *block, Dataset *ds);
+
+static bool isSpillCleanupRegistered = FALSE;
 
 /*
  *  addExternalEntry - add a relocation table entry to a referenced object block
@@ -143,6 +169,97 @@ void advanceBitPosition(Section *section, int count) {
     }
 }
 
+static int compareExternalEntries(const void *e1, const void *e2) {
+    ExternalTableEntry *x1;
+    ExternalTableEntry *x2;
+
+    x1 = (ExternalTableEntry *)e1;
+    x2 = (ExternalTableEntry *)e2;
+    if (x1->bitAddress != x2->bitAddress) return (x1->bitAddress < x2->bitAddress) ? -1 : 1;
+    if (x1->externalIndex != x2->externalIndex) return (x1->externalIndex < x2->externalIndex) ? -1 : 1;
+    if (x1->fieldLength != x2->fieldLength) return (x1->fieldLength < x2->fieldLength) ? -1 : 1;
+    return (int)x1->isParcelRelocation - (int)x2->isParcelRelocation;
+}
+
+static int compareRelocationEntries(const void *e1, const void *e2) {
+    RelocationTableEntry *r1;
+    RelocationTableEntry *r2;
+
+    r1 = (RelocationTableEntry *)e1;
+    r2 = (RelocationTableEntry *)e2;
+    if (r1->type != r2->type) return (r1->type < r2->type) ? -1 : 1;
+    if (r1->offset != r2->offset) return (r1->offset < r2->offset) ? -1 : 1;
+    if (r1->blockIndex != r2->blockIndex) return (r1->blockIndex < r2->blockIndex) ? -1 : 1;
+    if (r1->fieldLength != r2->fieldLength) return (r1->fieldLength < r2->fieldLength) ? -1 : 1;
+    return (int)r1->isParcelRelocation - (int)r2->isParcelRelocation;
+}
+
+/*
+ *  compactExternalTable, compactRelocationTable - sort the external or
+ *  relocation table entries of a block by the addresses of the fields to
+ *  which they apply, and remove duplicates
+ *
+ *  A field is relocated at most once, so an entry that repeats another
+ *  comes from a field that was emitted again, e.g., after an ORG, and
+ *  applying it twice would relocate the field twice.
+ */
+static void compactExternalTable(ObjectBlock *block) {
+    int i;
+    int n;
+
+    if (block->externalTableIndex < 2) return;
+    qsort(block->externalTable, block->externalTableIndex, sizeof(ExternalTableEntry), compareExternalEntries);
+    for (i = n = 1; i < block->externalTableIndex; i++) {
+        if (compareExternalEntries(&block->externalTable[i], &block->externalTable[n - 1]) != 0)
+            block->externalTable[n++] = block->externalTable[i];
+    }
+    relocationEntriesRemoved += block->externalTableIndex - n;
+    block->externalTableIndex = n;
+}
+
+static void compactRelocationTable(ObjectBlock *block) {
+    int i;
+    int n;
+
+    if (block->relocationTableIndex < 2) return;
+    qsort(block->relocationTable, block->relocationTableIndex, sizeof(RelocationTableEntry), compareRelocationEntries);
+    for (i = n = 1; i < block->relocationTableIndex; i++) {
+        if (compareRelocationEntries(&block->relocationTable[i], &block->relocationTable[n - 1]) != 0)
+            block->relocationTable[n++] = block->relocationTable[i];
+    }
+    relocationEntriesRemoved += block->relocationTableIndex - n;
+    block->relocationTableIndex = n;
+}
+
+/*
+ *  copyObjectSpill - copy the tables that have been written to the spill
+ *  dataset of a module
+ */
+static int copyObjectSpill(Module *module, Dataset *ds) {
+    u8 buf[COS_BLOCK_SIZE];
+    int n;
+
+#if !defined(__cos)
+    if (module->objectSpill->isWritable) {
+        if (cosDsWriteEOR(module->objectSpill) == -1 || cosDsWriteEOF(module->objectSpill) == -1
+            || cosDsWriteEOD(module->objectSpill) == -1 || cosDsClose(module->objectSpill) == -1) {
+            module->objectSpill = NULL;
+            return -1;
+        }
+        module->objectSpill = cosDsOpen(module->objectSpillPath);
+        if (module->objectSpill == NULL) return -1;
+    }
+    else if (cosDsRewind(module->objectSpill) == -1) {
+        return -1;
+    }
+#endif
+    while ((n = cosDsRead(module->objectSpill, buf, sizeof(buf))) > 0) {
+        if (cosDsWrite(ds, buf, n) != n) return -1;
+    }
+    (void)cosDsReadCW(module->objectSpill); // the EOR, so that the dataset can be copied again
+    return n;
+}
+
 static int countBlocks(Module *module) {
     ObjectBlock *block;
     int count;
@@ -298,6 +415,20 @@ void emitFieldBits(Section *section, Value *val, int len, bool doListFlush) {
     }
     fieldAttributes |= val->attributes;
     bits = (val->type == NumberType_Integer) ? val->value.intValue : toCrayFloat(val->value.intValue);
+    if (len == 64 && section->wordBitPosCounter == 0) {
+        //
+        //  Whole word aligned on a word boundary, e.g., from CON or DATA
+        //
+        putWord(section, section->originCounter, bits);
+        advanceBitPosition(section, 64);
+        listField(bits, 64, fieldAttributes, 21);
+        if (doListFlush) {
+            listFlush(section);
+            listCodeLocation(section);
+        }
+        fieldStartingBitPos = 0;
+        return;
+    }
     mask = ~((~(u64)0 >> len) << len);
     currentWord = getWord(section, section->originCounter);
     emptyBitCount = 64 - section->wordBitPosCounter;
@@ -406,8 +537,13 @@ void emitLiterals(Module *module) {
 void emitString(Section *section, char *s, int len, int count, JustifyType justification) {
     char *cp;
     int fillCount;
+    u8 fillValue;
+    int i;
+    bool isLastFlushed;
+    int j;
     char *limit;
     int n;
+    int total;
     Value val;
 
     n = 0;
@@ -418,44 +554,35 @@ void emitString(Section *section, char *s, int len, int count, JustifyType justi
     }
     if (n > count) n = count;
     fillCount = count - n;
+    fillValue = (justification == Justify_LeftBlankFill) ? 0x20 : 0;
+    if (justification == Justify_LeftZeroEnd && fillCount < 1) {
+        fillCount = 1;
+        n -= 1;
+    }
+    //
+    //  The listing is flushed after each full word except the last one,
+    //  unless a right justified string consists entirely of fill.
+    //
+    isLastFlushed = (justification == Justify_RightZeroFill && n < 1);
+    total = n + fillCount;
     val.type = NumberType_Integer;
     val.attributes = 0;
     val.section = section;
 
     emitFieldStart(section);
-    switch (justification) {
-    case Justify_LeftBlankFill:
-        while (n-- > 0) {
-            if (*s == '\'') s += 1;
-            val.value.intValue = *s++;
-            emitFieldBits(section, &val, 8, n > 0 || fillCount > 0);
-        }
-        val.value.intValue = 0x20;
-        while (fillCount-- > 0) emitFieldBits(section, &val, 8, fillCount > 0);
-        break;
-    case Justify_LeftZeroEnd:
-        if (fillCount < 1) {
-            fillCount = 1;
-            n -= 1;
-        }
-    case Justify_LeftZeroFill:
-        while (n-- > 0) {
-            if (*s == '\'') s += 1;
-            val.value.intValue = *s++;
-            emitFieldBits(section, &val, 8, n > 0 || fillCount > 0);
-        }
-        val.value.intValue = 0;
-        while (fillCount-- > 0) emitFieldBits(section, &val, 8, fillCount > 0);
-        break;
-    case Justify_RightZeroFill:
+    i = 0;
+    while (i < total) {
         val.value.intValue = 0;
-        while (fillCount-- > 0) emitFieldBits(section, &val, 8, TRUE);
-        while (n-- > 0) {
-            if (*s == '\'') s += 1;
-            val.value.intValue = *s++;
-            emitFieldBits(section, &val, 8, n > 0 || n > 0);
+        if (section->wordBitPosCounter == 0 && total - i >= 8) {
+            for (j = 0; j < 8; j++) {
+                val.value.intValue = (val.value.intValue << 8) | nextStringByte(&s, i++, n, fillCount, fillValue, justification);
+            }
+            emitFieldBits(section, &val, 64, i < total || isLastFlushed);
+        }
+        else {
+            val.value.intValue = nextStringByte(&s, i++, n, fillCount, fillValue, justification);
+            emitFieldBits(section, &val, 8, i < total || isLastFlushed);
         }
-        break;
     }
     emitFieldEnd(section);
 }
@@ -494,13 +621,9 @@ static u64 getWord(Section *section, u32 parcelAddress) {
     u64 word;
 
     if (pass == 1) return 0;
-    addr = (parcelAddress & 0xfffffc) * 2;
+    addr = mapImage(section, (parcelAddress & 0xfffffc) * 2, (parcelAddress & 0xfffffc) * 2 + 7);
     limit = addr + 7;
     block = section->objectBlock;
-    while (limit >= block->imageSize) {
-        block->image = (u8 *)reallocate(block->image, block->imageSize, block->imageSize + IMAGE_INCREMENT);
-        block->imageSize += IMAGE_INCREMENT;
-    }
     word = 0;
     while (addr <= limit) {
         word = (word << 8) | block->image[addr++];
@@ -509,6 +632,66 @@ static u64 getWord(Section *section, u32 parcelAddress) {
     return word;
 }
 
+/*
+ *  growImage - grow a module image to include the byte at offset limit
+ */
+static void growImage(ObjectBlock *block, u32 limit) {
+    u32 newSize;
+
+    //
+    //  The first allocation covers the size of the block determined in
+    //  pass 1, so the image is normally allocated just once. Beyond that,
+    //  the image doubles in size so that the cost of copying it remains
+    //  linear in its final size.
+    //
+    newSize = (block->image == NULL) ? block->offset * 2 : block->imageSize * 2;
+    if (newSize <= limit) newSize = limit + 1;
+    newSize = ((newSize + (IMAGE_INCREMENT - 1)) / IMAGE_INCREMENT) * IMAGE_INCREMENT;
+    if (isObjectStreamed && newSize > OBJECT_WINDOW_SIZE) newSize = OBJECT_WINDOW_SIZE;
+    block->image = (u8 *)reallocate(block->image, block->imageSize, newSize);
+    block->imageSize = newSize;
+    imageReallocationCount += 1;
+}
+
+/*
+ *  mapImage - ensure that a block's image holds the bytes from addr to limit,
+ *  and return the offset of addr in it
+ */
+static u32 mapImage(Section *section, u32 addr, u32 limit) {
+    ObjectBlock *block;
+
+    block = section->objectBlock;
+    if (isObjectStreamed) {
+        if (addr < block->imageBase) {
+            eprintf("Object code of block %s at parcel address %o was changed after it was streamed, assemble without -B",
+                (*block->id != '\0') ? block->id : "(nominal)", addr >> 1);
+            exit(1);
+        }
+        if (limit - block->imageBase >= OBJECT_WINDOW_SIZE) streamImage(section, addr & ~7);
+    }
+    if (limit - block->imageBase >= block->imageSize) growImage(block, limit - block->imageBase);
+    return addr - block->imageBase;
+}
+
+/*
+ *  nextStringByte - get byte i of a justified string, advancing *s past the
+ *  characters consumed
+ */
+static u8 nextStringByte(char **s, int i, int n, int fillCount, u8 fillValue, JustifyType justification) {
+    char *cp;
+
+    if (justification == Justify_RightZeroFill) {
+        if (i < fillCount) return 0;
+    }
+    else if (i >= n) {
+        return fillValue;
+    }
+    cp = *s;
+    if (*cp == '\'') cp += 1;
+    *s = cp + 1;
+    return (u8)*cp;
+}
+
 /*
  *  putHalfWord - put two parcels into a module image referenced by a parcel address
  */
@@ -525,13 +708,9 @@ static void putParcel(Section *section, u32 parcelAddress, u16 parcel) {
     ObjectBlock *block;
 
     if (pass == 1) return;
-    addr = parcelAddress * 2;
     block = section->objectBlock;
-    while (addr + 1 >= block->imageSize) {
-        if (block->image == NULL) block->lowestParcelAddress = parcelAddress;
-        block->image = (u8 *)reallocate(block->image, block->imageSize, block->imageSize + IMAGE_INCREMENT);
-        block->imageSize += IMAGE_INCREMENT;
-    }
+    if (block->image == NULL) block->lowestParcelAddress = parcelAddress;
+    addr = mapImage(section, parcelAddress * 2, parcelAddress * 2 + 1);
     block->image[addr] = parcel >> 8;
     block->image[addr + 1] = parcel & 0xff;
     block->isNotEmpty = TRUE;
@@ -543,39 +722,192 @@ static void putParcel(Section *section, u32 parcelAddress, u16 parcel) {
  *  putWord - put a word into a module image referenced by a parcel address
  */
 static void putWord(Section *section, u32 parcelAddress, u64 word) {
+    u32 addr;
+    ObjectBlock *block;
+    u8 *bp;
     int shiftCount;
 
-    if (pass == 2) {
-        parcelAddress &= 0xfffffc;
-        for (shiftCount = 48; shiftCount >= 0; shiftCount -= 16) {
-            putParcel(section, parcelAddress++, (word >> shiftCount) & 0xffff);
-        }
+    if (pass == 1) return;
+    parcelAddress &= 0xfffffc;
+    block = section->objectBlock;
+    if (block->image == NULL) block->lowestParcelAddress = parcelAddress;
+    addr = mapImage(section, parcelAddress * 2, parcelAddress * 2 + 7);
+    bp = block->image + addr;
+    for (shiftCount = 56; shiftCount >= 0; shiftCount -= 8) {
+        *bp++ = (word >> shiftCount) & 0xff;
     }
+    block->isNotEmpty = TRUE;
+    if (parcelAddress < block->lowestParcelAddress) block->lowestParcelAddress = parcelAddress;
+    if (parcelAddress + 3 > block->highestParcelAddress) block->highestParcelAddress = parcelAddress + 3;
 }
 
 /*
  *  reserveStorage - ensure that highest parcel address is not less than the origin counter
  */
 void reserveStorage(Section *section, u32 firstAddress, u32 count) {
-    u32 addr;
     ObjectBlock *block;
     u32 lastAddress;
-    u32 newSize;
 
     if (pass == 1 || count < 1) return;
     lastAddress = firstAddress + count - 1;
-    addr = lastAddress * 2;
     block = section->objectBlock;
-    newSize = (((addr + 1) + (IMAGE_INCREMENT - 1)) / IMAGE_INCREMENT) * IMAGE_INCREMENT;
-    if (newSize > block->imageSize) {
-        if (block->image == NULL) block->lowestParcelAddress = firstAddress;
-        block->image = (u8 *)reallocate(block->image, block->imageSize, newSize);
-        block->imageSize = newSize;
-    }
+    if (block->image == NULL) block->lowestParcelAddress = firstAddress;
+    (void)mapImage(section, lastAddress * 2, lastAddress * 2 + 1);
     if (firstAddress < block->lowestParcelAddress) block->lowestParcelAddress = firstAddress;
     if (lastAddress > block->highestParcelAddress) block->highestParcelAddress = lastAddress;
 }
 
+/*
+ *  releaseObjectSpills - release the spill datasets of the modules of the
+ *  current source file
+ */
+void releaseObjectSpills(void) {
+    Module *module;
+
+    for (module = firstModule; module != NULL; module = module->next) {
+        if (module->objectSpill == NULL && module->objectSpillPath == NULL) continue;
+        cosDsClose(module->objectSpill);
+        module->objectSpill = NULL;
+#if !defined(__cos)
+        if (module->objectSpillPath != NULL) unlink(module->objectSpillPath);
+#endif
+        free(module->objectSpillPath);
+        module->objectSpillPath = NULL;
+    }
+}
+
+/*
+ *  streamImage - write the part of a block's image that precedes byte
+ *  address base to the spill dataset of its module, and begin a new window
+ *  at base
+ *
+ *  The text table is followed by the relocation and external table entries
+ *  of the fields that end before base. The loader applies them to the text
+ *  that it has already loaded, so entries of fields that end beyond base
+ *  are kept for a later table.
+ */
+static void streamImage(Section *section, u32 base) {
+    ObjectBlock *block;
+    int fd;
+    u32 first;
+    u32 loadAddress;
+    Module *module;
+#if !defined(__cos)
+    char *tmpDir;
+#endif
+
+    block = section->objectBlock;
+    module = section->module;
+    if (objectFile != NULL) {
+#if !defined(__cos)
+        if (module->objectSpill == NULL) {
+            //
+            //  The spill datasets are removed when the process exits, so
+            //  that they are not left behind by errors that end assembly.
+            //
+            if (isSpillCleanupRegistered == FALSE) {
+                atexit(releaseObjectSpills);
+                isSpillCleanupRegistered = TRUE;
+            }
+            tmpDir = getenv("TMPDIR");
+            if (tmpDir == NULL || *tmpDir == '\0') tmpDir = "/tmp";
+            module->objectSpillPath = (char *)allocate(strlen(tmpDir) + 12);
+            sprintf(module->objectSpillPath, "%s/calXXXXXX", tmpDir);
+            fd = mkstemp(module->objectSpillPath);
+            if (fd == -1) {
+                perror(module->objectSpillPath);
+                free(module->objectSpillPath);
+                module->objectSpillPath = NULL;
+                exit(1);
+            }
+            module->objectSpill = cosDsCreateFd(fd);
+            if (module->objectSpill == NULL) {
+                perror(module->objectSpillPath);
+                close(fd);
+                exit(1);
+            }
+        }
+#endif
+        first = (block->lowestParcelAddress & 0xfffffc) * 2;
+        if (first < block->imageBase) first = block->imageBase;
+        loadAddress = first >> 1;
+        if ((block->type != SectionType_Mixed && block->type != SectionType_Code) || module->isAbsolute == FALSE)
+            loadAddress -= block->lowestParcelAddress & 0xfffffc;
+        if ((block->isNotEmpty
+             && first < base
+             && writeTXTRange(block, block->index, loadAddress, first >> 1, base >> 1, module->objectSpill) == -1)
+            || streamRelocations(block, base, module->objectSpill) == -1) {
+            eputs("Failed to write object code to spill file");
+            exit(1);
+        }
+    }
+    else {
+        block->relocationTableIndex = block->externalTableIndex = 0;
+    }
+    if (block->image != NULL) memset(block->image, 0, block->imageSize);
+    block->imageBase = base;
+}
+
+/*
+ *  streamRelocations - write the relocation and external table entries of
+ *  the fields of a block that end before byte address limit, and remove them
+ *  from the block's tables
+ */
+static int streamRelocations(ObjectBlock *block, u32 limit, Dataset *ds) {
+    ExternalTableEntry *externalEntry;
+    int externalCount;
+    int i;
+    int n;
+    RelocationTableEntry *relocationEntry;
+    int relocationCount;
+    u64 word;
+
+    relocationCount = block->relocationTableIndex;
+    externalCount = block->externalTableIndex;
+    //
+    //  Move the entries to be written to the front of the tables, write
+    //  them, then move the remaining entries down.
+    //
+    relocationEntry = (RelocationTableEntry *)allocate((relocationCount + 1) * sizeof(RelocationTableEntry));
+    for (i = n = 0; i < relocationCount; i++) {
+        if ((block->relocationTable[i].type == RelocEntryType_Standard
+             && (block->relocationTable[i].offset + 2) * 2 <= limit)
+            || (block->relocationTable[i].type == RelocEntryType_Extended
+                && block->relocationTable[i].offset / 8 + 1 <= limit)) {
+            block->relocationTable[n++] = block->relocationTable[i];
+        }
+        else {
+            relocationEntry[i - n] = block->relocationTable[i];
+        }
+    }
+    block->relocationTableIndex = n;
+    if (isRelocationCompacted) compactRelocationTable(block);
+    if (n > 0 && (writeStdBRT(block, ds) == -1 || writeExtBRT(block, ds) == -1)) return -1;
+    memcpy(block->relocationTable, relocationEntry, (relocationCount - n) * sizeof(RelocationTableEntry));
+    block->relocationTableIndex = relocationCount - n;
+    free(relocationEntry);
+
+    externalEntry = (ExternalTableEntry *)allocate((externalCount + 1) * sizeof(ExternalTableEntry));
+    for (i = n = 0; i < externalCount; i++) {
+        if (block->externalTable[i].bitAddress / 8 + 1 <= limit) {
+            block->externalTable[n++] = block->externalTable[i];
+        }
+        else {
+            externalEntry[i - n] = block->externalTable[i];
+        }
+    }
+    block->externalTableIndex = n;
+    if (isRelocationCompacted) compactExternalTable(block);
+    if (n > 0) {
+        word = ((u64)LDR_TT_XRT << 60) | ((u64)(block->externalTableIndex + 1) << 36);
+        if (cosDsWriteWord(ds, word) == -1 || writeXRTEntries(block, ds) == -1) return -1;
+    }
+    memcpy(block->externalTable, externalEntry, (externalCount - n) * sizeof(ExternalTableEntry));
+    block->externalTableIndex = externalCount - n;
+    free(externalEntry);
+    return 0;
+}
+
 
 /*
  *  toCrayFloat - map IEEE 754 floating point format to Cray format
@@ -731,7 +1063,17 @@ int writeObjectRecord(Module *module, Dataset *ds) {
     /*
      *  Write the Program Description Table (PDT)
      */
+    if (isRelocationCompacted) {
+        for (block = module->firstObjectBlock; block != NULL; block = block->next) {
+            compactRelocationTable(block);
+            compactExternalTable(block);
+        }
+    }
     if (writePDT(module, ds) == -1) return -1;
+    /*
+     *  Copy the tables written to the spill dataset, if any
+     */
+    if (module->objectSpill != NULL && copyObjectSpill(module, ds) == -1) return -1;
     /*
      *  Write a Text Table (TXT) for each non-empty object block
      */
@@ -938,40 +1280,57 @@ static int writeTrailer(Module *module, Dataset *ds) {
 }
 
 static int writeTXT(ObjectBlock *block, u8 index, bool isAbsolute, Dataset *ds) {
-    int byteCount;
     u32 firstParcelAddress;
-    u32 loadAddress;
+    u32 origin;
+
+    if (block->isNotEmpty == FALSE) return 0;
+    origin = block->lowestParcelAddress & 0xfffffc;
+    firstParcelAddress = (origin * 2 < block->imageBase) ? block->imageBase >> 1 : origin;
+    return writeTXTRange(block, index, isAbsolute ? firstParcelAddress : firstParcelAddress - origin,
+                         firstParcelAddress, (block->highestParcelAddress + 4) & 0xfffffc, ds);
+}
+
+/*
+ *  writeTXTRange - write a text table holding the words of a block's image
+ *  from parcel address first up to parcel address limit
+ *
+ *  Words beyond the part of the image held in memory are zero.
+ */
+static int writeTXTRange(ObjectBlock *block, u8 index, u32 loadAddress, u32 first, u32 limit, Dataset *ds) {
+    u32 addr;
+    int byteCount;
+    u32 end;
+    int n;
     u64 parcelCount;
     u64 word;
-    u64 wordCount;
-    u64 imageLength;
+    static u8 zeros[IMAGE_INCREMENT];
 
     //
     //  Write header word
     //
-    if (block->isNotEmpty) {
-        firstParcelAddress = block->lowestParcelAddress & 0xfffffc;
-        parcelCount = ((block->highestParcelAddress + 4) & 0xfffffc) - firstParcelAddress;
-        loadAddress = isAbsolute ? firstParcelAddress : 0;
-        word = ((u64)LDR_TT_TXT << 60) | (((parcelCount >> 2) + 1) << 36) | (index << 25) | (loadAddress >> 2);
+    parcelCount = limit - first;
+    word = ((u64)LDR_TT_TXT << 60) | (((parcelCount >> 2) + 1) << 36) | (index << 25) | (loadAddress >> 2);
+    if (cosDsWriteWord(ds, word) == -1) return -1;
+    if (block->image == NULL) return 0;
+    addr = first * 2;
+    end = limit * 2;
+    byteCount = block->imageBase + block->imageSize - addr;
+    if (byteCount > (int)(end - addr)) byteCount = end - addr;
+    if (byteCount > 0) {
+        if (cosDsWrite(ds, block->image + (addr - block->imageBase), byteCount) != byteCount) return -1;
+        addr += byteCount;
     }
-    else {
-        return 0;
+    while (addr < end) {
+        n = (end - addr > sizeof(zeros)) ? sizeof(zeros) : end - addr;
+        if (cosDsWrite(ds, zeros, n) != n) return -1;
+        addr += n;
     }
-    if (cosDsWriteWord(ds, word) == -1) return -1;
-    byteCount = parcelCount * 2;
-    if (block->image == NULL
-        || cosDsWrite(ds, block->image + (firstParcelAddress * 2), byteCount) == byteCount)
-        return 0;
-    else
-        return -1;
+    return 0;
 }
 
 static int writeXRT(Module *module, Dataset *ds) {
     ObjectBlock *block;
-    ExternalTableEntry *entry;
     u64 entryCount;
-    int i;
     u64 word;
 
     entryCount = 0;
@@ -984,15 +1343,24 @@ static int writeXRT(Module *module, Dataset *ds) {
     if (cosDsWriteWord(ds, word) == -1) return -1;
     
     for (block = module->firstObjectBlock; block != NULL; block = block->next) {
-        for (i = 0; i < block->externalTableIndex; i++) {
-            entry = &block->externalTable[i];
-            word = (u64)block->index << 51;
-            if (entry->isParcelRelocation) word |= (u64)1 << 50;
-            word |= (u64)entry->externalIndex << 36;
-            word |= (u64)(entry->fieldLength & 077) << 30;
-            word |= (u64)entry->bitAddress;
-            if (cosDsWriteWord(ds, word) == -1) return -1;
-        }
+        if (writeXRTEntries(block, ds) == -1) return -1;
+    }
+    return 0;
+}
+
+static int writeXRTEntries(ObjectBlock *block, Dataset *ds) {
+    ExternalTableEntry *entry;
+    int i;
+    u64 word;
+
+    for (i = 0; i < block->externalTableIndex; i++) {
+        entry = &block->externalTable[i];
+        word = (u64)block->index << 51;
+        if (entry->isParcelRelocation) word |= (u64)1 << 50;
+        word |= (u64)entry->externalIndex << 36;
+        word |= (u64)(entry->fieldLength & 077) << 30;
+        word |= (u64)entry->bitAddress;
+        if (cosDsWriteWord(ds, word) == -1) return -1;
     }
     return 0;
 }
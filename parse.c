@@ -32,6 +32,12 @@
 #include "fnv.h"
 #include "services.h"
 
+typedef struct fieldCacheEntry {
+    SourceFormatType format;
+    EditControl editControl;
+    char *line;  // source line followed by location, result, and operand fields
+} FieldCacheEntry;
+
 typedef struct opStackEntry {
     OperatorType type;
     u8 precedence;
@@ -50,6 +56,7 @@ static ErrorCode executeOperator(OperatorType opType);
 static MacroDefn *findMacroDefn(char *id, int len);
 static int findStringEnd(int cursor);
 static void getFields(void);
+static FieldCacheEntry *getFieldCacheEntry(void);
 static int getNextField(int cursor, int *start);
 static char *interpolateMicros(char *dst, int dstLen, char *src, int srcLen);
 static bool isRegisterDesignator(char *s, int len, Token *token);
@@ -63,10 +70,14 @@ static void popArg(Value *arg);
 static void popOp(OpStackEntry *op);
 static void pushArg(Value *arg);
 static void pushOp(Token *token);
+static void relocateSection(Section *section);
 static void resetLocationField(void);
 static void squishString(char *s, int len);
 
+static FieldCacheEntry *fieldCache = NULL;
+static int fieldCacheSize = 0;
 static char fields[(COLUMN_LIMIT+2)*3];
+static Section *relocatedSections = NULL;
 
 static char *operatorSymbols[] = { //  indexed by OperatorType
     "",
@@ -236,39 +247,39 @@ static int argStackPtr = 0;
 static OpStackEntry opStack[OP_STACK_SIZE];
 static int opStackPtr = 0;
 
-Token *copyToken(Token *token) {
+Token *copyToken(Token *token, Arena *arena) {
     Token *new;
 
     if (token == NULL) return NULL;
 
-    new = (Token *)allocate(sizeof(Token));
+    new = (Token *)arenaAllocate(arena, sizeof(Token));
     memcpy(new, token, sizeof(Token));
     switch (token->type) {
     case TokenType_Register:
         if (token->details.regster.ptr != NULL) {
-            new->details.regster.ptr = (char *)allocate(token->details.regster.len);
+            new->details.regster.ptr = (char *)arenaAllocate(arena, token->details.regster.len);
             memcpy(new->details.regster.ptr, token->details.regster.ptr, token->details.regster.len);
         }
         break;
     case TokenType_Name:
         if (token->details.name.ptr != NULL) {
-            new->details.name.ptr = (char *)allocate(token->details.name.len);
+            new->details.name.ptr = (char *)arenaAllocate(arena, token->details.name.len);
             memcpy(new->details.name.ptr, token->details.name.ptr, token->details.name.len);
         }
         if (token->details.name.qualPtr != NULL) {
-            new->details.name.qualPtr = (char *)allocate(token->details.name.qualLen);
+            new->details.name.qualPtr = (char *)arenaAllocate(arena, token->details.name.qualLen);
             memcpy(new->details.name.qualPtr, token->details.name.qualPtr, token->details.name.qualLen);
         }
         break;
     case TokenType_String:
         if (token->details.string.ptr != NULL) {
-            new->details.string.ptr = (char *)allocate(token->details.string.len);
+            new->details.string.ptr = (char *)arenaAllocate(arena, token->details.string.len);
             memcpy(new->details.string.ptr, token->details.string.ptr, token->details.string.len);
         }
         break;
     case TokenType_Operator:
-        new->details.operator.leftArg = copyToken(token->details.operator.leftArg);
-        new->details.operator.rightArg = copyToken(token->details.operator.rightArg);
+        new->details.operator.leftArg = copyToken(token->details.operator.leftArg, arena);
+        new->details.operator.rightArg = copyToken(token->details.operator.rightArg, arena);
         break;
     case TokenType_Number:
     case TokenType_None:
@@ -310,7 +321,7 @@ bool equalTokens(Token *t1, Token *t2) {
             && t1->details.string.len == t2->details.string.len
             && t1->details.string.count == t2->details.string.count
             && t1->details.string.justification == t2->details.string.justification)
-            return strncasecmp(t1->details.name.ptr, t2->details.name.ptr, t1->details.name.len) == 0;
+            return strncmp(t1->details.string.ptr, t2->details.string.ptr, t1->details.string.len) == 0;
         break;
     case TokenType_Operator:
         return t1->details.operator.type == t2->details.operator.type
@@ -342,20 +353,18 @@ ErrorCode evaluateExpression(Token *expression, Value *value) {
 
     argStackPtr = 0;
     opStackPtr = 0;
-    for (section = currentModule->firstSection; section != NULL; section = section->next) {
-         section->relocationCoefficient = section->immobileCoefficient = 0;
-    }
     err = evaluateExprHelper(expression);
     if (err == Err_None && argStackPtr == 1 && opStackPtr == 0) {
         popArg(value);
         if (isRelative(value)) {
+            relocateSection(value->section);
             if (isImmobile(value))
                 value->section->immobileCoefficient += value->coefficient;
             else
                 value->section->relocationCoefficient += value->coefficient;
         }
         relocationSection = NULL;
-        for (section = currentModule->firstSection; section != NULL; section = section->next) {
+        for (section = relocatedSections; section != NULL; section = section->nextRelocated) {
              if (section->relocationCoefficient == 1 && relocationSection == NULL) {
                  relocationSection = section;
              }
@@ -377,7 +386,8 @@ ErrorCode evaluateExpression(Token *expression, Value *value) {
         }
     }
     else if (err == Err_Undefined) {
-        value->attributes |= SYM_UNDEFINED;
+        value->type = NumberType_Integer;
+        value->attributes = SYM_UNDEFINED;
         value->section = NULL;
         value->value.intValue = 0;
     }
@@ -387,6 +397,11 @@ ErrorCode evaluateExpression(Token *expression, Value *value) {
         value->value.intValue = 0;
         if (err == Err_None) err = Err_Expression;
     }
+    for (section = relocatedSections; section != NULL; section = section->nextRelocated) {
+        section->relocationCoefficient = section->immobileCoefficient = 0;
+        section->isRelocated = FALSE;
+    }
+    relocatedSections = NULL;
     return err;
 }
 
@@ -482,8 +497,9 @@ static ErrorCode evaluateExprHelper(Token *expression) {
 static char *evaluateMicro(char *s, int len) {
     Name *name;
 
-    name = findName(currentModule->micros, s, len);
-    if (name == NULL) name = findName(defaultModule->micros, s, len);
+    microReferenceCount += 1;
+    name = findMicro(currentModule, s, len);
+    if (name == NULL) name = findMicro(defaultModule, s, len);
     if (name != NULL) return name->value;
     if (len == 4) {
         if (strncasecmp("$APP", s, len) == 0) {
@@ -504,9 +520,11 @@ static char *evaluateMicro(char *s, int len) {
             return ";";
         }
         else if (strncasecmp("$DATE", s, len) == 0) {
+            isTimeReferenced = TRUE;
             return currentDate;
         }
         else if (strncasecmp("$TIME", s, len) == 0) {
+            isTimeReferenced = TRUE;
             return currentTime;
         }
         else if (strncasecmp("$QUAL", s, len) == 0) {
@@ -514,6 +532,7 @@ static char *evaluateMicro(char *s, int len) {
         }
     }
     else if (len == 6 && strncasecmp("$JDATE", s, len) == 0) {
+        isTimeReferenced = TRUE;
         return currentJDate;
     }
     return "";
@@ -740,6 +759,7 @@ static ErrorCode executeOperator(OperatorType opType) {
         if (isExternal(&leftArg) && isExternal(&rightArg))
             err = registerError(Err_RelocatableField);
         if (isRelative(&rightArg)) {
+            relocateSection(rightArg.section);
             if (isImmobile(&rightArg))
                 rightArg.section->immobileCoefficient += rightArg.coefficient;
             else
@@ -813,6 +833,7 @@ static ErrorCode executeOperator(OperatorType opType) {
         if (isExternal(&leftArg) && isExternal(&rightArg))
             err = registerError(Err_RelocatableField);
         if (isRelative(&rightArg)) {
+            relocateSection(rightArg.section);
             if (isImmobile(&rightArg))
                 rightArg.section->immobileCoefficient -= rightArg.coefficient;
             else
@@ -1063,41 +1084,13 @@ static int findStringEnd(int cursor) {
     return cursor;
 }
 
-void freeToken(Token *token) {
-    if (token != NULL) {
-        switch (token->type) {
-        case TokenType_Register:
-            if (token->details.regster.ptr != NULL) free(token->details.regster.ptr);
-            break;
-        case TokenType_Name:
-            if (token->details.name.ptr != NULL) free(token->details.name.ptr);
-            if (token->details.name.qualPtr != NULL) free(token->details.name.qualPtr);
-            break;
-        case TokenType_String:
-            if (token->details.string.ptr != NULL) free(token->details.string.ptr);
-            break;
-        case TokenType_Operator:
-            freeToken(token->details.operator.leftArg);
-            freeToken(token->details.operator.rightArg);
-            break;
-        case TokenType_Number:
-        case TokenType_None:
-        case TokenType_Error:
-            // nothing more to free
-            break;
-        default:
-            eprintf("Invalid token type: %d", token->type);
-            break;
-        }
-        free(token);
-    }
-}
-
 static void getFields(void) {
     char c;
     int cursor;
+    FieldCacheEntry *entry;
     int i;
     int len;
+    int lineLength;
     int resultFieldEnd;
     char *s;
     int start;
@@ -1112,6 +1105,32 @@ static void getFields(void) {
     *operandField++ = ' ';
     *operandField = '\0';
     if (sourceLine[0] == '*') return;
+    //
+    //  Lines read from the source file that reference no micros split
+    //  identically in both passes, so reuse the fields found in pass 1.
+    //  Only the split is kept, not the token and expression trees built
+    //  from the fields: the pseudo and machine instruction handlers each
+    //  parse their own operands and free the trees when done, and values
+    //  in those trees, such as location counters and forward references,
+    //  differ between the passes.
+    //
+    entry = getFieldCacheEntry();
+    if (entry != NULL) {
+        if (entry->line != NULL
+            && entry->format == currentSourceFormat
+            && entry->editControl == currentEditControl
+            && strcmp(entry->line, sourceLine) == 0) {
+            s = entry->line + strlen(entry->line) + 1;
+            strcpy(locationField, s);
+            s += strlen(s) + 1;
+            strcpy(resultField, s);
+            s += strlen(s) + 1;
+            strcpy(operandField, s);
+            return;
+        }
+        if (entry->line != NULL) free(entry->line);
+        entry->line = NULL;
+    }
     cursor = 0;
     if (currentSourceFormat == SourceFormat_New) {
         while (cursor < COLUMN_LIMIT) {
@@ -1155,6 +1174,40 @@ static void getFields(void) {
             }
         }
     }
+    if (entry != NULL) {
+        lineLength = strlen(sourceLine);
+        len = strlen(locationField) + strlen(resultField) + strlen(operandField) + 3;
+        entry->line = (char *)allocate(lineLength + 1 + len);
+        s = entry->line;
+        strcpy(s, sourceLine);
+        s += lineLength + 1;
+        strcpy(s, locationField);
+        s += strlen(s) + 1;
+        strcpy(s, resultField);
+        s += strlen(s) + 1;
+        strcpy(s, operandField);
+        entry->format = currentSourceFormat;
+        entry->editControl = currentEditControl;
+    }
+}
+
+/*
+**  getFieldCacheEntry - return the field cache entry for the current
+**  source line, or NULL if the line came from a macro expansion or
+**  references micros, or if object code is streamed, which bounds memory
+*/
+static FieldCacheEntry *getFieldCacheEntry(void) {
+    int index;
+
+    if (isObjectStreamed) return NULL;
+    index = getSourceLineIndex();
+    if (index < 0 || strchr(sourceLine, '"') != NULL) return NULL;
+    if (index >= fieldCacheSize) {
+        fieldCache = (FieldCacheEntry *)reallocate(fieldCache, fieldCacheSize * sizeof(FieldCacheEntry),
+            (index + SOURCE_LINE_INCREMENT) * sizeof(FieldCacheEntry));
+        fieldCacheSize = index + SOURCE_LINE_INCREMENT;
+    }
+    return &fieldCache[index];
 }
 
 static int getNextField(int cursor, int *start) {
@@ -1539,7 +1592,6 @@ char *getNextValue(char *s, Value *value, ErrorCode *err) {
         *err = Err_Expression;
         break;
     }
-    freeToken(expression);
     return s;
 }
 
@@ -1598,6 +1650,63 @@ u16 getValueType(Value *value) {
     return value->attributes & (SYM_PARCEL_ADDRESS|SYM_WORD_ADDRESS);
 }
 
+/*
+**  hashToken - compute a hash of an expression, such that expressions
+**              considered equal by equalTokens have equal hashes
+*/
+u32 hashToken(Token *token) {
+    f64 floatValue;
+    Fnv32_t hash;
+    u32 leftHash;
+    u32 rightHash;
+
+    if (token == NULL) return 0;
+    hash = fnv32a((char *)&token->type, sizeof(token->type), FNV1_32A_INIT);
+    switch (token->type) {
+    case TokenType_Register:
+        hash = fnv32a((char *)&token->details.regster.type, sizeof(token->details.regster.type), hash);
+        if (token->details.regster.ptr != NULL)
+            hash ^= hashId(token->details.regster.ptr, token->details.regster.len);
+        else
+            hash = fnv32a((char *)&token->details.regster.ordinal, sizeof(token->details.regster.ordinal), hash);
+        break;
+    case TokenType_Name:
+        if (token->details.name.ptr != NULL)
+            hash ^= hashId(token->details.name.ptr, token->details.name.len);
+        break;
+    case TokenType_String:
+        hash = fnv32a((char *)&token->details.string.count, sizeof(token->details.string.count), hash);
+        hash = fnv32a((char *)&token->details.string.justification, sizeof(token->details.string.justification), hash);
+        if (token->details.string.ptr != NULL)
+            hash = fnv32a(token->details.string.ptr, token->details.string.len, hash);
+        break;
+    case TokenType_Operator:
+        hash = fnv32a((char *)&token->details.operator.type, sizeof(token->details.operator.type), hash);
+        leftHash = hashToken(token->details.operator.leftArg);
+        rightHash = hashToken(token->details.operator.rightArg);
+        hash = fnv32a((char *)&leftHash, sizeof(leftHash), hash);
+        hash = fnv32a((char *)&rightHash, sizeof(rightHash), hash);
+        break;
+    case TokenType_Number:
+        hash = fnv32a((char *)&token->details.number.type, sizeof(token->details.number.type), hash);
+        if (token->details.number.type == NumberType_Integer) {
+            hash = fnv32a((char *)&token->details.number.value.intValue, sizeof(i64), hash);
+        }
+        else {
+            floatValue = token->details.number.value.floatValue;
+            if (floatValue == 0.0) floatValue = 0.0; // -0.0 equals 0.0
+            hash = fnv32a((char *)&floatValue, sizeof(floatValue), hash);
+        }
+        break;
+    case TokenType_Error:
+        hash = fnv32a((char *)&token->details.error.code, sizeof(token->details.error.code), hash);
+        break;
+    default:
+        break;
+    }
+    return hash;
+}
+
 static char *interpolateMicros(char *dst, int dstLen, char *src, int srcLen) {
     char *dstLimit;
     char *micro;
@@ -1721,17 +1830,16 @@ char *parseExpression(char *s, Token **expression) {
     if (*s == '(') {
         s = parseExpression(s + 1, &rightArg);
         if (*s != ')') {
-            freeToken(rightArg);
             token.type = TokenType_Error;
             token.details.error.code = Err_Expression;
-            *expression = copyToken(&token);
+            *expression = copyToken(&token, &lineArena);
             return s;
         }
         memset(&token, 0, sizeof(Token));
         token.type = TokenType_Operator;
         token.details.operator.type = Op_SubExpr;
         token.details.operator.rightArg = rightArg;
-        leftArg = copyToken(&token);
+        leftArg = copyToken(&token, &lineArena);
         s += 1;
         if (*s == '\0' || *s == ',' || *s == ')') {
             *expression = leftArg;
@@ -1745,13 +1853,12 @@ char *parseExpression(char *s, Token **expression) {
     switch (token.type) {
     case TokenType_None:
         if (leftArg != NULL) {
-            freeToken(leftArg);
             token.type = TokenType_Error;
             token.details.error.code = Err_Expression;
-            *expression = copyToken(&token);
+            *expression = copyToken(&token, &lineArena);
         }
         else {
-            *expression = copyToken(&token);
+            *expression = copyToken(&token, &lineArena);
         }
         break;
     case TokenType_Register:
@@ -1759,16 +1866,15 @@ char *parseExpression(char *s, Token **expression) {
     case TokenType_Number:
     case TokenType_String:
         if (leftArg != NULL) {
-            freeToken(leftArg);
             token.type = TokenType_Error;
             token.details.error.code = Err_Expression;
-            *expression = copyToken(&token);
+            *expression = copyToken(&token, &lineArena);
         }
         else if (*s == '\0' || *s == ',' || *s == ')') {
-            *expression = copyToken(&token);
+            *expression = copyToken(&token, &lineArena);
         }
         else {
-            leftArg = copyToken(&token);
+            leftArg = copyToken(&token, &lineArena);
             s = getNextToken(s, &token);
             if (token.type == TokenType_Operator) {
                 switch (token.details.operator.type) {
@@ -1781,7 +1887,7 @@ char *parseExpression(char *s, Token **expression) {
                 case Op_And:
                 case Op_Or:
                 case Op_Xor:
-                    op = copyToken(&token);
+                    op = copyToken(&token, &lineArena);
                     op->details.operator.leftArg = leftArg;
                     s = parseExpression(s, &rightArg);
                     switch (rightArg->type) {
@@ -1794,27 +1900,23 @@ char *parseExpression(char *s, Token **expression) {
                         *expression = op;
                         break;
                     default:
-                        freeToken(rightArg);
-                        freeToken(op);
                         token.type = TokenType_Error;
                         token.details.error.code = Err_Expression;
-                        *expression = copyToken(&token);
+                        *expression = copyToken(&token, &lineArena);
                         break;
                     }
                     break;
                 default:
-                    freeToken(leftArg);
                     token.type = TokenType_Error;
                     token.details.error.code = Err_Expression;
-                    *expression = copyToken(&token);
+                    *expression = copyToken(&token, &lineArena);
                     break;
                 }
             }
             else {
-                freeToken(leftArg);
                 token.type = TokenType_Error;
                 token.details.error.code = Err_Expression;
-                *expression = copyToken(&token);
+                *expression = copyToken(&token, &lineArena);
             }
         }
         break;
@@ -1842,7 +1944,7 @@ char *parseExpression(char *s, Token **expression) {
                 break;
             }
         }
-        op = copyToken(&token);
+        op = copyToken(&token, &lineArena);
         s = parseExpression(s, &rightArg);
         switch (rightArg->type) {
         case TokenType_Register:
@@ -1855,22 +1957,19 @@ char *parseExpression(char *s, Token **expression) {
             *expression = op;
             break;
         default:
-            if (leftArg != NULL) freeToken(leftArg);
-            freeToken(rightArg);
-            freeToken(op);
             token.type = TokenType_Error;
             token.details.error.code = Err_Expression;
-            *expression = copyToken(&token);
+            *expression = copyToken(&token, &lineArena);
             break;
         }
         break;
     case TokenType_Error:
-        *expression = copyToken(&token);
+        *expression = copyToken(&token, &lineArena);
         break;
     default:
         token.type = TokenType_Error;
         token.details.error.code = Err_Expression;
-        *expression = copyToken(&token);
+        *expression = copyToken(&token, &lineArena);
         break;
     }
     return s;
@@ -2109,6 +2208,7 @@ ErrorCode parseSourceLine(void) {
     Token token;
 
     err = Err_None;
+    arenaReset(&lineArena);
     resetLocationField();
     resetErrorRegistrations();
     listSource();
@@ -2131,7 +2231,7 @@ ErrorCode parseSourceLine(void) {
     switch (token.type) {
     case TokenType_Name:
         if (*s == '\0' && isUnqualifiedName(&token)) {
-            locationFieldToken = copyToken(&token);
+            locationFieldToken = copyToken(&token, &lineArena);
         }
         else {
             err = registerError(Err_LocationField);
@@ -2371,11 +2471,38 @@ static void pushOp(Token *token) {
     stackEntry->precedence = token->details.operator.precedence;
 }
 
-static void resetLocationField(void) {
-    if (locationFieldToken != NULL) {
-        freeToken(locationFieldToken);
-        locationFieldToken = NULL;
+/*
+**  releaseFieldCache - release the field cache of the current source file
+*/
+void releaseFieldCache(void) {
+    int i;
+
+    for (i = 0; i < fieldCacheSize; i++) {
+        if (fieldCache[i].line != NULL) free(fieldCache[i].line);
     }
+    free(fieldCache);
+    fieldCache = NULL;
+    fieldCacheSize = 0;
+}
+
+/*
+ *  The sections whose coefficients an expression changes are kept in
+ *  order of their definition, so evaluateExpression examines them in the
+ *  same order as the sections of the module, and resets only them.
+ */
+static void relocateSection(Section *section) {
+    Section **link;
+
+    if (section->isRelocated) return;
+    section->isRelocated = TRUE;
+    link = &relocatedSections;
+    while (*link != NULL && (*link)->index < section->index) link = &(*link)->nextRelocated;
+    section->nextRelocated = *link;
+    *link = section;
+}
+
+static void resetLocationField(void) {
+    locationFieldToken = NULL;
 }
 
 static void squishString(char *s, int len) {
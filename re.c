@@ -26,6 +26,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include "calconst.h"
+#include "calproto.h"
+#include "caltypes.h"
+#include "services.h"
 
 /*
  *  This engine supports regular expressions containing:
@@ -132,91 +135,169 @@ static char *getNextClass(char *re, char *reLimit, char **class, int *hasZeroOrM
     return rp;
 }
 
-static int isMatch(char *class, char c) {
-    char *cp;
-
-    if (class == NULL) return TRUE;
-
-    cp = class;
-    while (*cp != '\0') {
-        if (*cp == c) return TRUE;
-        cp += 1;
-    }
-    return FALSE;
+static int isMember(ReOp *op, char c) {
+    return op->isAny || (op->members[(u8)c >> 3] & (1 << ((u8)c & 7))) != 0;
 }
 
-int applyRE(char *re, int reLen, char *s, int sLen, char **captures, int *lenCaptures, int maxCaptures, int *nCaptures) {
-    char *class;
+/*
+ *  applyCompiledRE - apply a regular expression compiled by compileRE
+ *
+ *  The results are the same as those of applyRE applied to the source of
+ *  the expression.
+ */
+int applyCompiledRE(CompiledRE *program, char *s, int sLen, char **captures, int *lenCaptures, int maxCaptures, int *nCaptures) {
     char *cpp;
-    int hasZeroOrMore;
     int nc;
-    char *reLimit;
-    char *rp;
+    ReOp *op;
+    ReOp *opLimit;
     char *sLimit;
     char *sp;
 
     cpp = NULL;
     nc = 0;
-    rp = re;
-    reLimit = rp + reLen;
+    op = program->ops;
+    opLimit = op + program->count;
     sp = s;
     sLimit = sp + sLen;
 
-    while (rp < reLimit && sp < sLimit) {
-        if (*rp == '(') {
+    while (op < opLimit && sp < sLimit) {
+        switch (op->type) {
+        case ReOpType_OpenCapture:
             if (cpp != NULL) return -1;
             cpp = sp;
-            rp += 1;
-            continue;
-        }
-        else if (*rp == ')') {
+            break;
+        case ReOpType_CloseCapture:
             if (cpp == NULL || nc >= maxCaptures) return -1;
             captures[nc] = cpp;
             lenCaptures[nc] = sp - cpp;
             nc += 1;
             cpp = NULL;
+            break;
+        case ReOpType_Class:
+            if (op->hasZeroOrMore) {
+                while (sp < sLimit && isMember(op, *sp)) sp += 1;
+            }
+            else if (isMember(op, *sp)) {
+                sp += 1;
+            }
+            else {
+                return 0;
+            }
+            break;
+        case ReOpType_SkipTo:
+            while (sp < sLimit && isMember(op, *sp) == FALSE) sp += 1;
+            if (op->hasZeroOrMore) {
+                while (sp < sLimit && isMember(op, *sp)) sp += 1;
+            }
+            else if (sp < sLimit ? isMember(op, *sp) : op->isAny) {
+                sp += 1;
+            }
+            else {
+                return 0;
+            }
+            break;
+        default:
+            return -1;
+        }
+        op += 1;
+    }
+
+    if (op < opLimit && op->type == ReOpType_CloseCapture && cpp != NULL && nc < maxCaptures) {
+        captures[nc] = cpp;
+        lenCaptures[nc] = sp - cpp;
+        nc += 1;
+        op += 1;
+    }
+
+    if (nCaptures != NULL) *nCaptures = nc;
+
+    return op >= opLimit && sp >= sLimit;
+}
+
+int applyRE(char *re, int reLen, char *s, int sLen, char **captures, int *lenCaptures, int maxCaptures, int *nCaptures) {
+    CompiledRE *program;
+    int rc;
+
+    program = compileRE(re, reLen);
+    rc = applyCompiledRE(program, s, sLen, captures, lenCaptures, maxCaptures, nCaptures);
+    free(program);
+
+    return rc;
+}
+
+/*
+ *  compileRE - compile a regular expression for repeated application
+ *
+ *  Each capture group delimiter and each character class becomes one
+ *  operation, with the class represented as a bit set. A '.*' (or other
+ *  unrestricted class with '*') together with the classes that follow it, up
+ *  to the first class that is not both unrestricted and repeated, becomes a
+ *  single operation that skips to that class. A syntax error becomes an
+ *  operation that fails when it is reached, so an expression is rejected
+ *  only when a subject string gets that far into it, as with applyRE.
+ */
+CompiledRE *compileRE(char *re, int reLen) {
+    char *class;
+    int hasZeroOrMore;
+    ReOp *op;
+    CompiledRE *program;
+    char *reLimit;
+    char *rp;
+
+    //
+    //  Every operation consumes at least one character of the expression.
+    //
+    program = (CompiledRE *)allocate(sizeof(CompiledRE) + reLen * sizeof(ReOp));
+    rp = re;
+    reLimit = rp + reLen;
+
+    while (rp < reLimit) {
+        op = &program->ops[program->count++];
+        if (*rp == '(') {
+            op->type = ReOpType_OpenCapture;
+            rp += 1;
+            continue;
+        }
+        else if (*rp == ')') {
+            op->type = ReOpType_CloseCapture;
             rp += 1;
             continue;
         }
         rp = getNextClass(rp, reLimit, &class, &hasZeroOrMore);
-        if (rp == NULL) return -1;
-        if (hasZeroOrMore) {
-            if (class != NULL) {
-                while (sp < sLimit && isMatch(class, *sp)) sp += 1;
-            }
-            else {
-                while (class == NULL && hasZeroOrMore) {
-                    rp = getNextClass(rp, reLimit, &class, &hasZeroOrMore);
-                    if (rp == NULL) return -1;
-                }
-                while (sp < sLimit && isMatch(class, *sp) == FALSE) sp += 1;
-                if (hasZeroOrMore) {
-                    while (sp < sLimit && isMatch(class, *sp)) sp += 1;
-                }
-                else if (isMatch(class, *sp)) {
-                    sp += 1;
+        if (rp != NULL && class == NULL && hasZeroOrMore) {
+            op->type = ReOpType_SkipTo;
+            while (rp != NULL && class == NULL && hasZeroOrMore) {
+                if (rp >= reLimit) {
+                    //
+                    //  Nothing follows, so the target is an empty class.
+                    //
+                    class = "";
+                    hasZeroOrMore = FALSE;
+                    rp = reLimit;
                 }
                 else {
-                    return 0;
+                    rp = getNextClass(rp, reLimit, &class, &hasZeroOrMore);
                 }
             }
         }
-        else if (isMatch(class, *sp)) {
-            sp += 1;
+        else {
+            op->type = ReOpType_Class;
+        }
+        if (rp == NULL) {
+            op->type = ReOpType_Error;
+            break;
+        }
+        op->hasZeroOrMore = hasZeroOrMore;
+        if (class == NULL) {
+            op->isAny = TRUE;
         }
         else {
-            return 0;
+            while (*class != '\0') {
+                op->members[(u8)*class >> 3] |= 1 << ((u8)*class & 7);
+                class += 1;
+            }
         }
     }
 
-    if (rp < reLimit && *rp == ')' && cpp != NULL && nc < maxCaptures) {
-        captures[nc] = cpp;
-        lenCaptures[nc] = sp - cpp;
-        nc += 1;
-        rp += 1;
-    }
-
-    if (nCaptures != NULL) *nCaptures = nc;
-
-    return rp >= reLimit && sp >= sLimit;
+    return program;
 }
@@ -0,0 +1,467 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright 2021 Kevin E. Jordan
+**
+**  Name: server.c
+**
+**  Description:
+**      This file provides functions that implement the assembly server
+**      (cal --server socket), which assembles jobs received through a Unix
+**      socket without rebuilding its instruction tables or reassembling
+**      external text files for each job, and the client that sends a job
+**      to the server named by the CALSERVER environment variable.
+**
+**  Licensed under the Apache License, Version 2.0 (the "License");
+**  you may not use this file except in compliance with the License.
+**  You may obtain a copy of the License at
+**
+**      http://www.apache.org/licenses/LICENSE-2.0
+**
+**  Unless required by applicable law or agreed to in writing, software
+**  distributed under the License is distributed on an "AS IS" BASIS,
+**  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**  See the License for the specific language governing permissions and
+**  limitations under the License.
+**
+**--------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calconst.h"
+#include "calproto.h"
+#include "caltypes.h"
+#include "services.h"
+
+#if defined(__cos)
+
+/*
+ *  The assembly server is not supported on COS itself.
+ */
+void requestJob(char *path, char *jobTextPath, int argc, char *argv[]) {
+}
+
+void serveJobs(char *path) {
+    exit(1);
+}
+
+#else
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define SERVER_ACCEPTED         'A'
+#define SERVER_BACKLOG          64
+#define SERVER_MAGIC            0x6b43414c
+#define SERVER_MAX_JOB_LENGTH   (1024*1024)
+#define SERVER_REJECTED         'R'
+
+/*
+ *  A job consists of the client's current directory, its TEXTPATH, and its
+ *  command line arguments, along with the connection to the client and the
+ *  client's standard input, output, and error files.
+ */
+typedef struct serverJob {
+    int fds[4];                 // connection, stdin, stdout, stderr
+    u8 *data;
+    u32 length;
+    char *cwd;
+    char *textPath;             // NULL if the client has no TEXTPATH
+    int argc;
+    char **argv;
+} ServerJob;
+
+static void closeJob(ServerJob *job);
+static bool openSocket(char *path, struct sockaddr_un *addr, int *fd);
+static bool readFully(int fd, void *buf, u32 len);
+static bool receiveJob(int fd, ServerJob *job, int *fds, int nfds);
+static void redirectStdio(ServerJob *job);
+static void runZygote(int ctrlFd, ServerJob *job);
+static bool sendJob(int fd, int *fds, int nfds, u8 *data, u32 length);
+static void startWorker(int ctrlFd, ServerJob *job, int textCount);
+static void startZygote(int listenFd, ServerJob *job, int *zygoteFd, pid_t *zygotePid);
+static bool writeFully(int fd, void *buf, u32 len);
+static bool writeStatus(int fd, int status);
+
+static void closeJob(ServerJob *job) {
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (job->fds[i] > 2) close(job->fds[i]);
+        job->fds[i] = -1;
+    }
+    if (job->data != NULL) free(job->data);
+    if (job->argv != NULL) free(job->argv);
+    job->data = NULL;
+    job->argv = NULL;
+}
+
+static bool openSocket(char *path, struct sockaddr_un *addr, int *fd) {
+    if (strlen(path) >= sizeof(addr->sun_path)) return FALSE;
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    *fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    return *fd != -1;
+}
+
+static bool readFully(int fd, void *buf, u32 len) {
+    u8 *bp;
+    int n;
+
+    bp = (u8 *)buf;
+    while (len > 0) {
+        n = read(fd, bp, len);
+        if (n <= 0) return FALSE;
+        bp += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+/*
+ *  receiveJob - receive a job, along with the nfds file descriptors that
+ *  accompany it
+ */
+static bool receiveJob(int fd, ServerJob *job, int *fds, int nfds) {
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * 4)];
+    } control;
+    char *cp;
+    int *fp;
+    u32 header[2];
+    int i;
+    struct iovec iov;
+    char *limit;
+    struct msghdr msg;
+    int n;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = header;
+    iov.iov_len = sizeof(header);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+    if (recvmsg(fd, &msg, 0) != sizeof(header)) return FALSE;
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) return FALSE;
+    fp = (int *)CMSG_DATA(cmsg);
+    n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    if (n != nfds) {
+        for (i = 0; i < n; i++) close(fp[i]);
+        return FALSE;
+    }
+    memcpy(fds, fp, sizeof(int) * nfds);
+    if (header[0] != SERVER_MAGIC || header[1] < 1 || header[1] > SERVER_MAX_JOB_LENGTH) return FALSE;
+    job->length = header[1];
+    job->data = (u8 *)allocate(job->length + 1);
+    if (readFully(fd, job->data, job->length) == FALSE) return FALSE;
+    //
+    //  The data is a sequence of null-terminated strings: the current
+    //  directory, the TEXTPATH prefixed by '=', or an empty string, and
+    //  the arguments.
+    //
+    cp = (char *)job->data;
+    limit = cp + job->length;
+    job->cwd = cp;
+    cp += strlen(cp) + 1;
+    if (cp >= limit) return FALSE;
+    job->textPath = (*cp == '=') ? cp + 1 : NULL;
+    cp += strlen(cp) + 1;
+    job->argc = 0;
+    for (i = 0; cp + i < limit; i++) {
+        if (cp[i] == '\0') job->argc += 1;
+    }
+    if (job->argc < 1) return FALSE;
+    job->argv = (char **)allocate((job->argc + 1) * sizeof(char *));
+    for (i = 0; i < job->argc; i++) {
+        job->argv[i] = cp;
+        cp += strlen(cp) + 1;
+    }
+    return TRUE;
+}
+
+static void redirectStdio(ServerJob *job) {
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (job->fds[i + 1] != i) dup2(job->fds[i + 1], i);
+    }
+}
+
+/*
+**  requestJob - send the current command line to the assembly server listening
+**               on a socket, and exit with the status of the job
+**
+**  If the server cannot be reached, the command line is assembled locally.
+*/
+void requestJob(char *path, char *jobTextPath, int argc, char *argv[]) {
+    struct sockaddr_un addr;
+    char *cp;
+    char cwd[MAX_FILE_PATH_LENGTH+1];
+    u8 *data;
+    int fd;
+    int fds[3];
+    int i;
+    u32 length;
+    int status;
+
+    if (getcwd(cwd, sizeof(cwd)) == NULL || openSocket(path, &addr, &fd) == FALSE) return;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        close(fd);
+        return;
+    }
+    length = strlen(cwd) + 1 + ((jobTextPath != NULL) ? strlen(jobTextPath) + 2 : 1);
+    for (i = 0; i < argc; i++) length += strlen(argv[i]) + 1;
+    data = (u8 *)allocate(length);
+    cp = (char *)data;
+    strcpy(cp, cwd);
+    cp += strlen(cp) + 1;
+    if (jobTextPath != NULL) {
+        *cp++ = '=';
+        strcpy(cp, jobTextPath);
+        cp += strlen(cp);
+    }
+    cp += 1;
+    for (i = 0; i < argc; i++) {
+        strcpy(cp, argv[i]);
+        cp += strlen(cp) + 1;
+    }
+    for (i = 0; i < 3; i++) fds[i] = i;
+    signal(SIGPIPE, SIG_IGN);
+    if (sendJob(fd, fds, 3, data, length) == FALSE) {
+        signal(SIGPIPE, SIG_DFL);
+        free(data);
+        close(fd);
+        return;
+    }
+    free(data);
+    if (readFully(fd, &status, sizeof(status)) == FALSE) {
+        eprintf("Lost connection to assembly server %s", path);
+        exit(1);
+    }
+    exit(status);
+}
+
+/*
+ *  runZygote - assemble the external text files of a job, then start a worker
+ *  for each job received from the server that names the same text files
+ *
+ *  The worker is forked from the zygote, so it starts with the definitions
+ *  of the text files in place. Jobs that name other text files are rejected,
+ *  and the server replaces the zygote with one that assembles them.
+ */
+static void runZygote(int ctrlFd, ServerJob *job) {
+    int fd;
+    char reply;
+    int textCount;
+
+    signal(SIGCHLD, SIG_IGN);
+    redirectStdio(job);
+    if (chdir(job->cwd) != 0) {
+        perror(job->cwd);
+        exit(1);
+    }
+    textCount = assembleJobText(job->argc, job->argv, job->textPath);
+    fflush(NULL);
+    fd = open("/dev/null", O_RDWR);
+    if (fd != -1) {
+        dup2(fd, 0);
+        dup2(fd, 1);
+        dup2(fd, 2);
+        close(fd);
+    }
+    while (TRUE) {
+        startWorker(ctrlFd, job, textCount);
+        closeJob(job);
+        reply = SERVER_ACCEPTED;
+        if (writeFully(ctrlFd, &reply, 1) == FALSE) exit(0);
+        while (TRUE) {
+            if (receiveJob(ctrlFd, job, job->fds, 4) == FALSE) exit(0);
+            if (chdir(job->cwd) == 0 && isJobTextCurrent(job->argc, job->argv, job->textPath)) break;
+            closeJob(job);
+            reply = SERVER_REJECTED;
+            if (writeFully(ctrlFd, &reply, 1) == FALSE) exit(0);
+        }
+    }
+}
+
+static bool sendJob(int fd, int *fds, int nfds, u8 *data, u32 length) {
+    struct cmsghdr *cmsg;
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int) * 4)];
+    } control;
+    u32 header[2];
+    struct iovec iov;
+    struct msghdr msg;
+
+    header[0] = SERVER_MAGIC;
+    header[1] = length;
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = header;
+    iov.iov_len = sizeof(header);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+    return sendmsg(fd, &msg, 0) == sizeof(header) && writeFully(fd, data, length);
+}
+
+/*
+**  serveJobs - assemble the jobs received through a socket, and never return
+**
+**  Each job is assembled by a worker process forked from a zygote process
+**  that holds the instruction tables and the definitions of the external
+**  text files named by the job, so that a worker resets all per-job state
+**  simply by exiting.
+*/
+void serveJobs(char *path) {
+    struct sockaddr_un addr;
+    int conn;
+    bool isAccepted;
+    ServerJob job;
+    int listenFd;
+    char reply;
+    int zygoteFd;
+    pid_t zygotePid;
+
+    if (openSocket(path, &addr, &listenFd) == FALSE) {
+        eprintf("Failed to create socket %s", path);
+        exit(1);
+    }
+    unlink(path);
+    if (bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(listenFd, SERVER_BACKLOG) == -1) {
+        perror(path);
+        exit(1);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    memset(&job, 0, sizeof(job));
+    zygoteFd = -1;
+    zygotePid = -1;
+    while (TRUE) {
+        conn = accept(listenFd, NULL, NULL);
+        if (conn == -1) continue;
+        job.fds[0] = conn;
+        job.fds[1] = job.fds[2] = job.fds[3] = -1;
+        if (receiveJob(conn, &job, &job.fds[1], 3) == FALSE) {
+            closeJob(&job);
+            continue;
+        }
+        isAccepted = zygoteFd != -1
+            && sendJob(zygoteFd, job.fds, 4, job.data, job.length)
+            && readFully(zygoteFd, &reply, 1)
+            && reply == SERVER_ACCEPTED;
+        if (isAccepted == FALSE) {
+            if (zygoteFd != -1) {
+                close(zygoteFd);
+                waitpid(zygotePid, NULL, 0);
+            }
+            startZygote(listenFd, &job, &zygoteFd, &zygotePid);
+            if (readFully(zygoteFd, &reply, 1) == FALSE) {
+                //
+                //  The zygote failed to assemble the text files of the job,
+                //  and has reported why to the client.
+                //
+                writeStatus(conn, 1);
+                close(zygoteFd);
+                waitpid(zygotePid, NULL, 0);
+                zygoteFd = -1;
+            }
+        }
+        closeJob(&job);
+    }
+}
+
+/*
+ *  startWorker - start a process that assembles a job and reports its exit
+ *  status to the client
+ *
+ *  The job is assembled by a grandchild of the zygote, which the child waits
+ *  for, so that the zygote need never wait for anything but its next job.
+ */
+static void startWorker(int ctrlFd, ServerJob *job, int textCount) {
+    pid_t pid;
+    int status;
+
+    fflush(NULL);
+    pid = fork();
+    if (pid == -1) {
+        writeStatus(job->fds[0], 1);
+        return;
+    }
+    if (pid > 0) return;
+    close(ctrlFd);
+    signal(SIGCHLD, SIG_DFL);
+    pid = fork();
+    if (pid == 0) {
+        signal(SIGPIPE, SIG_DFL);
+        close(job->fds[0]);
+        redirectStdio(job);
+        assembleJob(job->argc, job->argv, job->textPath, textCount);
+        exit(1);
+    }
+    status = 1;
+    if (pid != -1 && waitpid(pid, &status, 0) == pid) {
+        status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+    writeStatus(job->fds[0], status);
+    exit(0);
+}
+
+static void startZygote(int listenFd, ServerJob *job, int *zygoteFd, pid_t *zygotePid) {
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+        perror("socketpair");
+        exit(1);
+    }
+    fflush(NULL);
+    *zygotePid = fork();
+    if (*zygotePid == -1) {
+        perror("fork");
+        exit(1);
+    }
+    if (*zygotePid == 0) {
+        close(listenFd);
+        close(fds[0]);
+        runZygote(fds[1], job);
+    }
+    close(fds[1]);
+    *zygoteFd = fds[0];
+}
+
+static bool writeFully(int fd, void *buf, u32 len) {
+    u8 *bp;
+    int n;
+
+    bp = (u8 *)buf;
+    while (len > 0) {
+        n = write(fd, bp, len);
+        if (n <= 0) return FALSE;
+        bp += n;
+        len -= n;
+    }
+    return TRUE;
+}
+
+static bool writeStatus(int fd, int status) {
+    return writeFully(fd, &status, sizeof(status));
+}
+
+#endif /* __cos */
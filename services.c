@@ -34,6 +34,9 @@
 #include <execinfo.h>
 #endif
 
+long allocationCount = 0;
+long reallocationCount = 0;
+
 void printStackTrace(FILE *fp) {
 #if defined(__APPLE__)
     void *callstack[128];
@@ -53,6 +56,7 @@ void printStackTrace(FILE *fp) {
 void *allocate(int size) {
     void *new;
 
+    allocationCount += 1;
     new = malloc((size_t)size);
     if (new == NULL) {
         eprintf("Failed to allocate %d bytes", size);
@@ -92,6 +96,7 @@ void eputs(char *s) {
 void *reallocate(void *old, int oldSize, int newSize) {
     void *new;
 
+    reallocationCount += 1;
     new = realloc(old, (size_t)newSize);
     if (new == NULL) {
         eprintf("Failed to reallocate %d bytes", newSize);
@@ -24,6 +24,9 @@
 **--------------------------------------------------------------------------
 */
 
+extern long allocationCount;
+extern long reallocationCount;
+
 void *allocate(int size);
 void eprintf(char *format, ...);
 void eputs(char *s);
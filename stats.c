@@ -0,0 +1,200 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright 2021 Kevin E. Jordan
+**
+**  Name: stats.c
+**
+**  Description:
+**      This file provides functions that measure the time spent in each
+**      phase of assembly, and that report the measurements, along with
+**      counts of the items created and the work done, as text (-S) or as
+**      JSON (-J).
+**
+**  Licensed under the Apache License, Version 2.0 (the "License");
+**  you may not use this file except in compliance with the License.
+**  You may obtain a copy of the License at
+**
+**      http://www.apache.org/licenses/LICENSE-2.0
+**
+**  Unless required by applicable law or agreed to in writing, software
+**  distributed under the License is distributed on an "AS IS" BASIS,
+**  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**  See the License for the specific language governing permissions and
+**  limitations under the License.
+**
+**--------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "calconst.h"
+#include "calproto.h"
+#include "caltypes.h"
+#include "services.h"
+#if !defined(__cos)
+#include <sys/time.h>
+#endif
+
+static void getTimes(double *wall, double *cpu);
+static int nameTreeDepth(Name *name);
+static int qualifierTreeDepth(Qualifier *qualifier);
+
+static double phaseCpuStarts[StatsPhase_Count];
+static double phaseWallStarts[StatsPhase_Count];
+
+static char *phaseNames[StatsPhase_Count] = {
+    "pass1",
+    "literals",
+    "objectBlocks",
+    "pass2",
+    "listing",
+    "objectCode"
+};
+
+/*
+**  endPhase - add the time elapsed since startPhase to a phase
+*/
+void endPhase(StatsPhase phase) {
+    double cpu;
+    double wall;
+
+    getTimes(&wall, &cpu);
+    assemblyStats.phases[phase].wall += wall - phaseWallStarts[phase];
+    assemblyStats.phases[phase].cpu  += cpu - phaseCpuStarts[phase];
+}
+
+static void getTimes(double *wall, double *cpu) {
+#if !defined(__cos)
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    *wall = tv.tv_sec + tv.tv_usec / 1000000.0;
+    *cpu = (double)clock() / CLOCKS_PER_SEC;
+#else
+    *wall = *cpu = (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+**  mergeStats - add the statistics of an assembly job to those of this process
+*/
+void mergeStats(AssemblyStats *stats) {
+    int i;
+
+    for (i = 0; i < StatsPhase_Count; i++) {
+        assemblyStats.phases[i].wall += stats->phases[i].wall;
+        assemblyStats.phases[i].cpu  += stats->phases[i].cpu;
+    }
+    assemblyStats.linesRead += stats->linesRead;
+    assemblyStats.macroLinesGenerated += stats->macroLinesGenerated;
+    assemblyStats.symbolsCreated += stats->symbolsCreated;
+    assemblyStats.qualifiersCreated += stats->qualifiersCreated;
+    assemblyStats.literalsCreated += stats->literalsCreated;
+    assemblyStats.objectBytesWritten += stats->objectBytesWritten;
+    if (stats->macroTreeDepth > assemblyStats.macroTreeDepth) assemblyStats.macroTreeDepth = stats->macroTreeDepth;
+    if (stats->qualifierTreeDepth > assemblyStats.qualifierTreeDepth)
+        assemblyStats.qualifierTreeDepth = stats->qualifierTreeDepth;
+}
+
+static int nameTreeDepth(Name *name) {
+    int left;
+    int right;
+
+    if (name == NULL) return 0;
+    left = nameTreeDepth(name->left);
+    right = nameTreeDepth(name->right);
+    return 1 + ((left > right) ? left : right);
+}
+
+static int qualifierTreeDepth(Qualifier *qualifier) {
+    int left;
+    int right;
+
+    if (qualifier == NULL) return 0;
+    left = qualifierTreeDepth(qualifier->left);
+    right = qualifierTreeDepth(qualifier->right);
+    return 1 + ((left > right) ? left : right);
+}
+
+/*
+**  recordTreeDepths - record the depths of the name trees of the modules
+**                     assembled from the current source file, if they are
+**                     the deepest seen so far
+*/
+void recordTreeDepths(void) {
+    int depth;
+    Module *module;
+
+    for (module = firstModule; module != NULL; module = module->next) {
+        depth = nameTreeDepth(module->macros);
+        if (depth > assemblyStats.macroTreeDepth) assemblyStats.macroTreeDepth = depth;
+        depth = qualifierTreeDepth(module->qualifiers);
+        if (depth > assemblyStats.qualifierTreeDepth) assemblyStats.qualifierTreeDepth = depth;
+    }
+}
+
+/*
+**  reportStats - write the statistics report as text
+*/
+void reportStats(FILE *fp) {
+    double cpu;
+    int i;
+    double wall;
+
+    fputs("phase              wall (s)   cpu (s)\n", fp);
+    cpu = wall = 0.0;
+    for (i = 0; i < StatsPhase_Count; i++) {
+        fprintf(fp, "%-16s %10.3f %9.3f\n", phaseNames[i], assemblyStats.phases[i].wall, assemblyStats.phases[i].cpu);
+        wall += assemblyStats.phases[i].wall;
+        cpu += assemblyStats.phases[i].cpu;
+    }
+    fprintf(fp, "%-16s %10.3f %9.3f\n", "total", wall, cpu);
+    fprintf(fp, "%-21s %ld\n", "lines read", assemblyStats.linesRead);
+    fprintf(fp, "%-21s %ld\n", "macro lines generated", assemblyStats.macroLinesGenerated);
+    fprintf(fp, "%-21s %ld\n", "symbols created", assemblyStats.symbolsCreated);
+    fprintf(fp, "%-21s %ld\n", "qualifiers created", assemblyStats.qualifiersCreated);
+    fprintf(fp, "%-21s %ld\n", "literals created", assemblyStats.literalsCreated);
+    fprintf(fp, "%-21s %ld\n", "micro references", microReferenceCount);
+    fprintf(fp, "%-21s %d\n", "macro tree depth", assemblyStats.macroTreeDepth);
+    fprintf(fp, "%-21s %d\n", "qualifier tree depth", assemblyStats.qualifierTreeDepth);
+    fprintf(fp, "%-21s %ld\n", "allocations", allocationCount);
+    fprintf(fp, "%-21s %ld\n", "reallocations", reallocationCount);
+    fprintf(fp, "%-21s %ld\n", "object bytes written", assemblyStats.objectBytesWritten);
+    fprintf(fp, "%-21s %ld\n", "relocations removed", relocationEntriesRemoved);
+}
+
+/*
+**  reportStatsJSON - write the statistics report as a JSON object
+*/
+void reportStatsJSON(FILE *fp) {
+    int i;
+
+    fputs("{\n  \"phases\": {\n", fp);
+    for (i = 0; i < StatsPhase_Count; i++) {
+        fprintf(fp, "    \"%s\": {\"wall\": %.6f, \"cpu\": %.6f}%s\n", phaseNames[i],
+                assemblyStats.phases[i].wall, assemblyStats.phases[i].cpu, (i + 1 < StatsPhase_Count) ? "," : "");
+    }
+    fputs("  },\n  \"counters\": {\n", fp);
+    fprintf(fp, "    \"linesRead\": %ld,\n", assemblyStats.linesRead);
+    fprintf(fp, "    \"macroLinesGenerated\": %ld,\n", assemblyStats.macroLinesGenerated);
+    fprintf(fp, "    \"symbolsCreated\": %ld,\n", assemblyStats.symbolsCreated);
+    fprintf(fp, "    \"qualifiersCreated\": %ld,\n", assemblyStats.qualifiersCreated);
+    fprintf(fp, "    \"literalsCreated\": %ld,\n", assemblyStats.literalsCreated);
+    fprintf(fp, "    \"microReferences\": %ld,\n", microReferenceCount);
+    fprintf(fp, "    \"macroTreeDepth\": %d,\n", assemblyStats.macroTreeDepth);
+    fprintf(fp, "    \"qualifierTreeDepth\": %d,\n", assemblyStats.qualifierTreeDepth);
+    fprintf(fp, "    \"allocations\": %ld,\n", allocationCount);
+    fprintf(fp, "    \"reallocations\": %ld,\n", reallocationCount);
+    fprintf(fp, "    \"objectBytesWritten\": %ld,\n", assemblyStats.objectBytesWritten);
+    fprintf(fp, "    \"relocationEntriesRemoved\": %ld\n", relocationEntriesRemoved);
+    fputs("  }\n}\n", fp);
+}
+
+/*
+**  startPhase - begin timing a phase
+*/
+void startPhase(StatsPhase phase) {
+    getTimes(&phaseWallStarts[phase], &phaseCpuStarts[phase]);
+}
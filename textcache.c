@@ -0,0 +1,541 @@
+/*--------------------------------------------------------------------------
+**
+**  Copyright 2021 Kevin E. Jordan
+**
+**  Name: textcache.c
+**
+**  Description:
+**      This file provides functions that save the macros, micros, qualifiers,
+**      and symbols defined by an external text file (-t) to a binary cache
+**      file in the cache directory (-c), and that restore them from the cache
+**      file on subsequent runs, so that unchanged text files need not be
+**      reassembled.
+**
+**  Licensed under the Apache License, Version 2.0 (the "License");
+**  you may not use this file except in compliance with the License.
+**  You may obtain a copy of the License at
+**
+**      http://www.apache.org/licenses/LICENSE-2.0
+**
+**  Unless required by applicable law or agreed to in writing, software
+**  distributed under the License is distributed on an "AS IS" BASIS,
+**  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+**  See the License for the specific language governing permissions and
+**  limitations under the License.
+**
+**--------------------------------------------------------------------------
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "calconst.h"
+#include "calproto.h"
+#include "caltypes.h"
+#include "fnv.h"
+#include "services.h"
+
+#if defined(__cos)
+
+/*
+ *  Text caching is not supported on COS itself.
+ */
+void invalidateTextCache(void) {
+}
+
+bool loadTextCache(void) {
+    return FALSE;
+}
+
+void saveTextCache(void) {
+}
+
+#else
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEXT_CACHE_INCREMENT 4096
+#define TEXT_CACHE_MAGIC     "kCALTXC"
+#define TEXT_CACHE_NULL      0xffffffff
+#define TEXT_CACHE_SUFFIX    ".txc"
+#define TEXT_CACHE_VERSION   2
+
+typedef struct cacheBuffer {
+    u8 *data;
+    u32 size;
+    u32 length;
+    u32 cursor;
+} CacheBuffer;
+
+static u32 countNames(Name *name);
+static u32 countQualifiers(Qualifier *qualifier);
+static void getCachePath(char *path);
+static Section *getSectionByIndex(int index);
+static int getSectionIndex(Section *section);
+static bool isCacheable(void);
+static bool isQualifierCacheable(Qualifier *qualifier);
+static bool makeKey(void);
+static void putBytes(CacheBuffer *buf, u8 *bytes, u32 len);
+static void putMacros(CacheBuffer *buf, Name *name);
+static void putMicros(CacheBuffer *buf, Module *module);
+static void putQualifiers(CacheBuffer *buf, Qualifier *qualifier);
+static void putString(CacheBuffer *buf, char *s);
+static void putU32(CacheBuffer *buf, u32 value);
+static void putU64(CacheBuffer *buf, u64 value);
+static void restoreMacros(CacheBuffer *buf);
+static void restoreMicros(CacheBuffer *buf);
+static void restoreQualifiers(CacheBuffer *buf);
+static char *takeString(CacheBuffer *buf);
+static u32 takeU32(CacheBuffer *buf);
+static u64 takeU64(CacheBuffer *buf);
+
+static Fnv32_t     chainHash = FNV1_32A_INIT;
+static bool        isChainValid = TRUE;
+static CacheBuffer key;
+
+static u32 countNames(Name *name) {
+    return (name == NULL) ? 0 : 1 + countNames(name->left) + countNames(name->right);
+}
+
+static u32 countQualifiers(Qualifier *qualifier) {
+    return (qualifier == NULL) ? 0 : 1 + countQualifiers(qualifier->left) + countQualifiers(qualifier->right);
+}
+
+static void getCachePath(char *path) {
+    sprintf(path, "%s/%08x%s", objectCacheDir, fnv32a((char *)key.data, key.length, FNV1_32A_INIT), TEXT_CACHE_SUFFIX);
+}
+
+static Section *getSectionByIndex(int index) {
+    Section *sp;
+
+    if (index < 0) return NULL;
+    sp = defaultModule->firstSection;
+    while (index-- > 0 && sp != NULL) sp = sp->next;
+    return sp;
+}
+
+static int getSectionIndex(Section *section) {
+    int index;
+    Section *sp;
+
+    if (section == NULL) return -1;
+    for (index = 0, sp = defaultModule->firstSection; sp != NULL; index++, sp = sp->next) {
+        if (sp == section) return index;
+    }
+    return -2;
+}
+
+/*
+**  invalidateTextCache - disable text caching for the remainder of the run
+**
+**  The state captured by a cache file is valid only when the text files
+**  preceding it are the same as when it was written, so caching stops once
+**  an ordinary source file has been assembled.
+*/
+void invalidateTextCache(void) {
+    isChainValid = FALSE;
+}
+
+/*
+**  isCacheable - determine whether assembling a text file left only state
+**                that a cache file can represent
+**
+**  Source format and edit control settings carry from a text file into the
+**  sources that follow it, and are not saved, so a text file that leaves
+**  them other than at their defaults is not cached. Nor is one that refers
+**  to the date or time micros, whose values differ on each run.
+*/
+static bool isCacheable(void) {
+    Section *section;
+
+    if (getErrorCount() > 0 || getWarningCount() > 0 || firstModule != NULL || isTimeReferenced) return FALSE;
+    if (currentSourceFormat != defaultSourceFormat || sourceFormatStackPtr != 0
+        || currentEditControl != defaultEditControl || editControlStackPtr != 0)
+        return FALSE;
+    if (defaultModule->literals != NULL || defaultModule->entryPoints != NULL
+        || defaultModule->externals != NULL || defaultModule->start != NULL
+        || defaultModule->comment != NULL || defaultModule->isAbsolute || defaultModule->stackSize != 0)
+        return FALSE;
+    for (section = defaultModule->firstSection; section != NULL; section = section->next) {
+        if (section->size != 0) return FALSE;
+    }
+    return isQualifierCacheable(defaultModule->qualifiers);
+}
+
+static bool isQualifierCacheable(Qualifier *qualifier) {
+    Symbol *symbol;
+
+    if (qualifier == NULL) return TRUE;
+    for (symbol = qualifier->firstSymbol; symbol != NULL; symbol = symbol->nextInQualifier) {
+        if (isExternal(&symbol->value) || getSectionIndex(symbol->value.section) < -1) return FALSE;
+    }
+    return isQualifierCacheable(qualifier->left) && isQualifierCacheable(qualifier->right);
+}
+
+/*
+**  loadTextCache - restore the definitions of the current external text
+**                  file from its cache file, if the cache file is current
+*/
+bool loadTextCache(void) {
+    CacheBuffer buf;
+    char cachePath[MAX_FILE_PATH_LENGTH+16];
+    FILE *fp;
+    Module *savedModule;
+    struct stat st;
+
+    key.length = 0;
+    isTimeReferenced = FALSE;
+    if (objectCacheDir == NULL) return FALSE;
+    mkdir(objectCacheDir, 0755);
+    if (makeKey() == FALSE) return FALSE;
+    getCachePath(cachePath);
+    if (stat(cachePath, &st) != 0 || st.st_size < key.length + 4) return FALSE;
+    fp = fopen(cachePath, "rb");
+    if (fp == NULL) return FALSE;
+    buf.size = buf.length = st.st_size;
+    buf.data = (u8 *)allocate(buf.size);
+    buf.cursor = 0;
+    if (fread(buf.data, 1, buf.length, fp) != buf.length
+        || memcmp(buf.data, key.data, key.length) != 0) {
+        fclose(fp);
+        free(buf.data);
+        return FALSE;
+    }
+    fclose(fp);
+    buf.cursor = buf.length - 4;
+    if (takeU32(&buf) != fnv32a((char *)buf.data, buf.length - 4, FNV1_32A_INIT)) {
+        free(buf.data);
+        return FALSE;
+    }
+    buf.length -= 4;
+    buf.cursor = key.length;
+    savedModule = currentModule;
+    currentModule = defaultModule;
+    restoreMacros(&buf);
+    restoreMicros(&buf);
+    restoreQualifiers(&buf);
+    currentModule = savedModule;
+    free(buf.data);
+    chainHash = fnv32a((char *)key.data, key.length, chainHash);
+    return TRUE;
+}
+
+/*
+**  makeKey - build the header that identifies the cache file of the current
+**            external text file
+**
+**  The header combines the cache format and assembler versions, the options
+**  that influence assembly of text, the size, modification time, and FNV-1a
+**  hash of the source, and a hash of the keys of the text files that preceded
+**  it in the current run.
+*/
+static bool makeKey(void) {
+    struct stat st;
+
+    key.length = 0;
+    if (isChainValid == FALSE) return FALSE;
+    if (stat(sourceFilePath, &st) != 0) {
+        isChainValid = FALSE;
+        return FALSE;
+    }
+    putBytes(&key, (u8 *)TEXT_CACHE_MAGIC, sizeof(TEXT_CACHE_MAGIC));
+    putU32(&key, TEXT_CACHE_VERSION);
+    putString(&key, calVersion);
+    putU32(&key, (isImplicitExternals ? 1 : 0) | (isSectionStackingEnabled ? 2 : 0));
+    putU32(&key, chainHash);
+    putU64(&key, (u64)sourceBufferLength);
+    putU64(&key, (u64)st.st_mtime);
+    putU32(&key, fnv32a(sourceBuffer, sourceBufferLength, FNV1_32A_INIT));
+    return TRUE;
+}
+
+static void putBytes(CacheBuffer *buf, u8 *bytes, u32 len) {
+    while (buf->length + len > buf->size) {
+        buf->data = (u8 *)reallocate(buf->data, buf->size, buf->size + TEXT_CACHE_INCREMENT);
+        buf->size += TEXT_CACHE_INCREMENT;
+    }
+    memcpy(buf->data + buf->length, bytes, len);
+    buf->length += len;
+}
+
+/*
+ *  Name trees are written in preorder, so that restoring them by repeated
+ *  insertion reproduces their shape.
+ */
+static void putMacros(CacheBuffer *buf, Name *name) {
+    MacroDefn *defn;
+    MacroFragment *fp;
+    MacroLine *lp;
+    u32 n;
+    MacroParam *pp;
+
+    if (name == NULL) return;
+    defn = (MacroDefn *)name->value;
+    putString(buf, name->id);
+    putU32(buf, defn->creationPass);
+    putString(buf, (defn->locationParam != NULL) ? defn->locationParam->name : NULL);
+    for (n = 0, pp = defn->params; pp != NULL; pp = pp->next) n += 1;
+    putU32(buf, n);
+    for (pp = defn->params; pp != NULL; pp = pp->next) {
+        putU32(buf, pp->type);
+        putString(buf, pp->name);
+        putString(buf, pp->value);
+    }
+    for (n = 0, lp = defn->body; lp != NULL; lp = lp->next) n += 1;
+    putU32(buf, n);
+    for (lp = defn->body; lp != NULL; lp = lp->next) {
+        for (n = 0, fp = lp->fragments; fp != NULL; fp = fp->next) n += 1;
+        putU32(buf, n);
+        for (fp = lp->fragments; fp != NULL; fp = fp->next) {
+            putU32(buf, fp->type);
+            putString(buf, fp->text);
+            putU32(buf, fp->paramIndex);
+        }
+    }
+    putMacros(buf, name->left);
+    putMacros(buf, name->right);
+}
+
+static void putMicros(CacheBuffer *buf, Module *module) {
+    u32 i;
+    Name *name;
+
+    for (i = 0; i < module->microIndexSize; i++) {
+        for (name = module->microIndex[i]; name != NULL; name = name->nextInChain) {
+            putString(buf, name->id);
+            putString(buf, (char *)name->value);
+        }
+    }
+}
+
+static void putQualifiers(CacheBuffer *buf, Qualifier *qualifier) {
+    Symbol *symbol;
+
+    if (qualifier == NULL) return;
+    putString(buf, qualifier->id);
+    putU32(buf, qualifier->symbolCount);
+    for (symbol = qualifier->firstSymbol; symbol != NULL; symbol = symbol->nextInQualifier) {
+        putString(buf, symbol->id);
+        putU32(buf, symbol->externalIndex);
+        putU32(buf, symbol->value.type);
+        putU32(buf, symbol->value.attributes);
+        putU32(buf, (u32)getSectionIndex(symbol->value.section));
+        putU32(buf, symbol->value.coefficient);
+        putU64(buf, (u64)symbol->value.value.intValue);
+    }
+    putQualifiers(buf, qualifier->left);
+    putQualifiers(buf, qualifier->right);
+}
+
+static void putString(CacheBuffer *buf, char *s) {
+    u32 len;
+
+    if (s == NULL) {
+        putU32(buf, TEXT_CACHE_NULL);
+    }
+    else {
+        len = strlen(s);
+        putU32(buf, len);
+        putBytes(buf, (u8 *)s, len);
+    }
+}
+
+static void putU32(CacheBuffer *buf, u32 value) {
+    u8 bytes[4];
+    int i;
+
+    for (i = 3; i >= 0; i--) {
+        bytes[i] = value & 0xff;
+        value >>= 8;
+    }
+    putBytes(buf, bytes, 4);
+}
+
+static void putU64(CacheBuffer *buf, u64 value) {
+    putU32(buf, (u32)(value >> 32));
+    putU32(buf, (u32)value);
+}
+
+static void restoreMacros(CacheBuffer *buf) {
+    u32 count;
+    MacroDefn *defn;
+    MacroFragment *fp;
+    MacroFragment **fpp;
+    char *id;
+    MacroLine *lp;
+    MacroLine **lpp;
+    u32 m;
+    u32 n;
+    Name *name;
+    MacroParam *pp;
+    MacroParam **ppp;
+
+    count = takeU32(buf);
+    while (count-- > 0) {
+        id = takeString(buf);
+        name = findName(currentModule->macros, id, strlen(id));
+        if (name == NULL) {
+            name = addName(&currentModule->macros, id, strlen(id));
+        }
+        else {
+            freeMacroDefn((MacroDefn *)name->value);
+        }
+        free(id);
+        defn = (MacroDefn *)allocate(sizeof(MacroDefn));
+        defn->creationPass = takeU32(buf);
+        name->value = defn;
+        id = takeString(buf);
+        if (id != NULL) {
+            defn->locationParam = (MacroParam *)allocate(sizeof(MacroParam));
+            defn->locationParam->name = id;
+        }
+        ppp = &defn->params;
+        for (n = takeU32(buf); n > 0; n--) {
+            pp = (MacroParam *)allocate(sizeof(MacroParam));
+            pp->type = (MacroParamType)takeU32(buf);
+            pp->index = ++defn->paramCount;
+            pp->name = takeString(buf);
+            pp->value = takeString(buf);
+            *ppp = pp;
+            ppp = &pp->next;
+        }
+        lpp = &defn->body;
+        for (n = takeU32(buf); n > 0; n--) {
+            lp = (MacroLine *)allocate(sizeof(MacroLine));
+            fpp = &lp->fragments;
+            for (m = takeU32(buf); m > 0; m--) {
+                fp = (MacroFragment *)allocate(sizeof(MacroFragment));
+                fp->type = (MacroFragType)takeU32(buf);
+                fp->text = takeString(buf);
+                fp->paramIndex = takeU32(buf);
+                if (fp->type == MacroFragType_Regex) fp->program = compileRE(fp->text, strlen(fp->text));
+                *fpp = fp;
+                fpp = &fp->next;
+            }
+            *lpp = lp;
+            lpp = &lp->next;
+        }
+    }
+}
+
+static void restoreMicros(CacheBuffer *buf) {
+    u32 count;
+    char *id;
+    Name *name;
+
+    count = takeU32(buf);
+    while (count-- > 0) {
+        id = takeString(buf);
+        name = addMicro(currentModule, id, strlen(id));
+        if (name->value != NULL) free(name->value);
+        name->value = takeString(buf);
+        free(id);
+    }
+}
+
+static void restoreQualifiers(CacheBuffer *buf) {
+    u32 count;
+    char *id;
+    u32 n;
+    Qualifier *qualifier;
+    Symbol *symbol;
+    Value val;
+
+    count = takeU32(buf);
+    while (count-- > 0) {
+        id = takeString(buf);
+        qualifier = findQualifier(id);
+        if (qualifier == NULL) qualifier = addQualifier(id, strlen(id));
+        free(id);
+        for (n = takeU32(buf); n > 0; n--) {
+            id = takeString(buf);
+            memset(&val, 0, sizeof(val));
+            symbol = findSymbol(id, strlen(id), qualifier);
+            if (symbol == NULL) symbol = addSymbol(id, strlen(id), qualifier, &val);
+            free(id);
+            symbol->externalIndex = takeU32(buf);
+            symbol->value.type = (NumberType)takeU32(buf);
+            symbol->value.attributes = takeU32(buf);
+            symbol->value.section = getSectionByIndex((int)takeU32(buf));
+            symbol->value.externalSymbol = NULL;
+            symbol->value.coefficient = takeU32(buf);
+            symbol->value.value.intValue = (i64)takeU64(buf);
+        }
+    }
+}
+
+/*
+**  saveTextCache - write the definitions produced by assembling the current
+**                  external text file to its cache file
+*/
+void saveTextCache(void) {
+    CacheBuffer buf;
+    char cachePath[MAX_FILE_PATH_LENGTH+16];
+    FILE *fp;
+    int n;
+    char tempPath[MAX_FILE_PATH_LENGTH+32];
+
+    if (key.length < 1) return;
+    chainHash = fnv32a((char *)key.data, key.length, chainHash);
+    if (isCacheable() == FALSE) return;
+    memset(&buf, 0, sizeof(buf));
+    putBytes(&buf, key.data, key.length);
+    putU32(&buf, countNames(defaultModule->macros));
+    putMacros(&buf, defaultModule->macros);
+    putU32(&buf, defaultModule->microCount);
+    putMicros(&buf, defaultModule);
+    putU32(&buf, countQualifiers(defaultModule->qualifiers));
+    putQualifiers(&buf, defaultModule->qualifiers);
+    putU32(&buf, fnv32a((char *)buf.data, buf.length, FNV1_32A_INIT));
+    //
+    //  Write to a temporary file and rename it, so that concurrent
+    //  assemblies never see a partially written cache file.
+    //
+    getCachePath(cachePath);
+    sprintf(tempPath, "%s.%d", cachePath, (int)getpid());
+    fp = fopen(tempPath, "wb");
+    if (fp != NULL) {
+        n = fwrite(buf.data, 1, buf.length, fp);
+        if (fclose(fp) != 0 || n != buf.length || rename(tempPath, cachePath) != 0) unlink(tempPath);
+    }
+    free(buf.data);
+}
+
+static char *takeString(CacheBuffer *buf) {
+    u32 len;
+    char *s;
+
+    len = takeU32(buf);
+    if (len == TEXT_CACHE_NULL) return NULL;
+    if (buf->cursor + len > buf->length) {
+        eputs("Text cache file is corrupt");
+        exit(1);
+    }
+    s = (char *)allocate(len + 1);
+    memcpy(s, buf->data + buf->cursor, len);
+    buf->cursor += len;
+    return s;
+}
+
+static u32 takeU32(CacheBuffer *buf) {
+    int i;
+    u32 value;
+
+    if (buf->cursor + 4 > buf->length) {
+        eputs("Text cache file is corrupt");
+        exit(1);
+    }
+    value = 0;
+    for (i = 0; i < 4; i++) value = (value << 8) | buf->data[buf->cursor++];
+    return value;
+}
+
+static u64 takeU64(CacheBuffer *buf) {
+    u64 value;
+
+    value = (u64)takeU32(buf) << 32;
+    return value | takeU32(buf);
+}
+
+#endif /* __cos */
@@ -22,23 +22,28 @@
 **--------------------------------------------------------------------------
 */
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "calconst.h"
 #include "calproto.h"
 #include "caltypes.h"
+#include "fnv.h"
 #include "services.h"
 
 static void adjustSymValsForQuals(Qualifier *qualifier);
-static void adjustSymValsForSyms(Symbol *symbol);
+static void adjustSymValsForSyms(Qualifier *qualifier);
 static Name *allocName(char *id, int len);
 static Qualifier *allocQualifier(char *id, int len);
 static Symbol *allocSymbol(char *id, int len, Value *value);
 static void freeName(Name *name);
 static void freeQualifier(Qualifier *qualifier);
-static void freeSymbol(Symbol *symbol);
 static void resetSection(Section *section);
+static void resizeLiteralIndex(Module *module);
+static void resizeMicroIndex(Module *module);
+static void resizeSectionIndex(Module *module);
+static void resizeSymbolIndex(Qualifier *qualifier);
 
 /*
 **  addEntryPoint - add an entry point definition to a module's chain of them
@@ -85,28 +90,35 @@ void addExternal(Module *module, Symbol *symbol) {
 }
 
 Literal *addLiteral(Token *expression) {
+    u32 hash;
     Literal *lp;
-    Literal *newLiteral;
-
-    if (currentModule->literals == NULL) {
-        newLiteral = (Literal *)allocate(sizeof(Literal));
-        newLiteral->expression = copyToken(expression);
-        currentModule->literals = newLiteral;
-        return newLiteral;
+    Literal **slot;
+
+    hash = hashToken(expression);
+    if (currentModule->literalIndex != NULL) {
+        lp = currentModule->literalIndex[hash & (currentModule->literalIndexSize - 1)];
+        while (lp != NULL) {
+            if (lp->hash == hash && equalTokens(expression, lp->expression)) return lp;
+            lp = lp->nextInChain;
+        }
+    }
+    if (currentModule->literalCount >= currentModule->literalIndexSize) resizeLiteralIndex(currentModule);
+    lp = (Literal *)allocate(sizeof(Literal));
+    lp->expression = copyToken(expression, &moduleArena);
+    lp->hash = hash;
+    slot = &currentModule->literalIndex[hash & (currentModule->literalIndexSize - 1)];
+    lp->nextInChain = *slot;
+    *slot = lp;
+    if (currentModule->lastLiteral != NULL) {
+        currentModule->lastLiteral->next = lp;
     }
     else {
-        lp = currentModule->literals;
-        while (TRUE) {
-            if (equalTokens(expression, lp->expression)) return lp;
-            if (lp->next == NULL) {
-                newLiteral = (Literal *)allocate(sizeof(Literal));
-                newLiteral->expression = copyToken(expression);
-                lp->next = newLiteral;
-                return newLiteral;
-            }
-            lp = lp->next;
-        }
+        currentModule->literals = lp;
     }
+    currentModule->lastLiteral = lp;
+    currentModule->literalCount += 1;
+    assemblyStats.literalsCreated += 1;
+    return lp;
 }
 
 ErrorCode addLocationSymbol(Section *section, char *id, int len, u16 attributes) {
@@ -148,6 +160,24 @@ ErrorCode addLocationSymbol(Section *section, char *id, int len, u16 attributes)
     return err;
 }
 
+/*
+**  addMicro - find a micro of a module, adding it if it does not exist
+*/
+Name *addMicro(Module *module, char *id, int len) {
+    Name *name;
+    Name **slot;
+
+    name = findMicro(module, id, len);
+    if (name != NULL) return name;
+    if (module->microCount >= module->microIndexSize) resizeMicroIndex(module);
+    name = allocName(id, len);
+    slot = &module->microIndex[hashId(id, len) & (module->microIndexSize - 1)];
+    name->nextInChain = *slot;
+    *slot = name;
+    module->microCount += 1;
+    return name;
+}
+
 Module *addModule(char *id, int len) {
     Section *section;
     Module *module;
@@ -248,6 +278,7 @@ Qualifier *addQualifier(char *id, int len) {
     current = currentModule->qualifiers;
     if (current == NULL) {
         currentModule->qualifiers = new;
+        assemblyStats.qualifiersCreated += 1;
         return new;
     }
     while (current != NULL) {
@@ -283,11 +314,21 @@ Qualifier *addQualifier(char *id, int len) {
             break;
         }
     }
+    if (new != NULL) assemblyStats.qualifiersCreated += 1;
     return new;
 }
 
+/*
+**  addSection - add a section to a module
+**
+**  Sections are indexed by id. The first section with an id is entered in
+**  the module's hash index, and those that follow it with the same id are
+**  linked to it in the order in which they are added.
+*/
 Section *addSection(Module *module, char *id, int len, SectionType type, SectionLocation location) {
+    Section *same;
     Section *section;
+    Section **slot;
 
     section = (Section *)allocate(sizeof(Section));
     section->id = (char *)allocate(len + 1);
@@ -295,6 +336,18 @@ Section *addSection(Module *module, char *id, int len, SectionType type, Section
     section->module = module;
     section->type = type;
     section->location = location;
+    section->index = module->sectionCount;
+    same = findSection(module, id, len);
+    if (same != NULL) {
+        while (same->nextSameId != NULL) same = same->nextSameId;
+        same->nextSameId = section;
+    }
+    else {
+        if (module->sectionCount >= module->sectionIndexSize) resizeSectionIndex(module);
+        slot = &module->sectionIndex[hashId(id, len) & (module->sectionIndexSize - 1)];
+        section->nextInChain = *slot;
+        *slot = section;
+    }
     if (module->lastSection != NULL) {
         module->lastSection->next = section;
     }
@@ -302,53 +355,29 @@ Section *addSection(Module *module, char *id, int len, SectionType type, Section
         module->firstSection = section;
     }
     module->lastSection = section;
+    module->sectionCount += 1;
     return section;
 }
 
 Symbol *addSymbol(char *id, int len, Qualifier *qualifier, Value *value) {
-    Symbol *current;
     Symbol *new;
-    int valence;
+    Symbol **slot;
 
+    if (findSymbol(id, len, qualifier) != NULL) return NULL;
+    if (qualifier->symbolCount >= qualifier->symbolIndexSize) resizeSymbolIndex(qualifier);
     new = allocSymbol(id, len, value);
-    current = qualifier->symbols;
-    if (current == NULL) {
-        qualifier->symbols = new;
-        return new;
+    slot = &qualifier->symbolIndex[hashId(id, len) & (qualifier->symbolIndexSize - 1)];
+    new->nextInChain = *slot;
+    *slot = new;
+    if (qualifier->lastSymbol != NULL) {
+        qualifier->lastSymbol->nextInQualifier = new;
     }
-    while (current != NULL) {
-        valence = strncasecmp(current->id, id, len);
-        if (valence > 0) {
-            if (current->left != NULL) {
-                current = current->left;
-            }
-            else {
-                current->left = new;
-                break;
-            }
-        }
-        else if (valence < 0) {
-            if (current->right != NULL) {
-                current = current->right;
-            }
-            else {
-                current->right = new;
-                break;
-            }
-        }
-        else if (current->id[len] == '\0') {
-            freeSymbol(new);
-            new = NULL;
-            break;
-        }
-        else if (current->left != NULL) {
-            current = current->left;
-        }
-        else {
-            current->left = new;
-            break;
-        }
+    else {
+        qualifier->firstSymbol = new;
     }
+    qualifier->lastSymbol = new;
+    qualifier->symbolCount += 1;
+    assemblyStats.symbolsCreated += 1;
     return new;
 }
 
@@ -358,14 +387,16 @@ void adjustSymbolValues(Module *module) {
 
 static void adjustSymValsForQuals(Qualifier *qualifier) {
     if (qualifier == NULL) return;
-    adjustSymValsForSyms(qualifier->symbols);
+    adjustSymValsForSyms(qualifier);
     adjustSymValsForQuals(qualifier->left);
     adjustSymValsForQuals(qualifier->right);
 }
 
-static void adjustSymValsForSyms(Symbol *symbol) {
-    if (symbol == NULL) return;
-    if (symbol->value.section != NULL) {
+static void adjustSymValsForSyms(Qualifier *qualifier) {
+    Symbol *symbol;
+
+    for (symbol = qualifier->firstSymbol; symbol != NULL; symbol = symbol->nextInQualifier) {
+        if (symbol->value.section == NULL) continue;
         if ((symbol->value.attributes & SYM_WORD_ADDRESS) != 0)
             symbol->value.value.intValue += symbol->value.section->originOffset >> 2;
         else if ((symbol->value.attributes & SYM_PARCEL_ADDRESS) != 0)
@@ -373,8 +404,6 @@ static void adjustSymValsForSyms(Symbol *symbol) {
         else if ((symbol->value.attributes & SYM_BYTE_ADDRESS) != 0)
             symbol->value.value.intValue += symbol->value.section->originOffset * 2;
     }
-    adjustSymValsForSyms(symbol->left);
-    adjustSymValsForSyms(symbol->right);
 }
 
 static Name *allocName(char *id, int len) {
@@ -403,8 +432,8 @@ static Symbol *allocSymbol(char *id, int len, Value *value) {
     Symbol *symbol;
     char *s;
 
-    s = (char *)allocate(len + 1);
-    symbol = (Symbol *)allocate(sizeof(Symbol));
+    s = (char *)arenaAllocate(&moduleArena, len + 1);
+    symbol = (Symbol *)arenaAllocate(&moduleArena, sizeof(Symbol));
     memcpy(s, id, len);
     symbol->id = s;
     symbol->value.type = value->type;
@@ -414,9 +443,17 @@ static Symbol *allocSymbol(char *id, int len, Value *value) {
     return symbol;
 }
 
+/*
+**  createObjectBlocks - assign the sections of a module to object blocks
+**
+**  Sections with the same id, type, and location share an object block, so
+**  a section's block, if it has one already, is that of an earlier section
+**  with the same id. Blocks are numbered in order of their first sections.
+*/
 void createObjectBlocks(Module *module) {
     u16 index;
     ObjectBlock *objectBlock;
+    Section *same;
     Section *section;
 
     index = 0;
@@ -424,10 +461,12 @@ void createObjectBlocks(Module *module) {
         if (section->size < 1
             && (strcmp(section->id, "") == 0 || strcmp(section->id, "=") == 0))
             continue;
-        for (objectBlock = module->firstObjectBlock; objectBlock != NULL; objectBlock = objectBlock->next) {
-            if (objectBlock->type == section->type && objectBlock->location == section->location
-                && strcasecmp(objectBlock->id, section->id) == 0)
+        objectBlock = NULL;
+        for (same = findSection(module, section->id, strlen(section->id)); same != section; same = same->nextSameId) {
+            if (same->objectBlock != NULL && same->type == section->type && same->location == section->location) {
+                objectBlock = same->objectBlock;
                 break;
+            }
         }
         if (objectBlock == NULL) {
             objectBlock = (ObjectBlock *)allocate(sizeof(ObjectBlock));
@@ -449,6 +488,18 @@ void createObjectBlocks(Module *module) {
     }
 }
 
+Name *findMicro(Module *module, char *id, int len) {
+    Name *current;
+
+    if (module->microIndex == NULL) return NULL;
+    current = module->microIndex[hashId(id, len) & (module->microIndexSize - 1)];
+    while (current != NULL) {
+        if (strncasecmp(current->id, id, (size_t)len) == 0 && current->id[len] == '\0') break;
+        current = current->nextInChain;
+    }
+    return current;
+}
+
 Module *findModule(char *id, int len) {
     Module *module;
     Name *name;
@@ -547,19 +598,12 @@ Qualifier *findQualifierWithLen(char *id, int len) {
 
 Symbol *findSymbol(char *id, int len, Qualifier *qualifier) {
     Symbol *current;
-    int valence;
 
-    current = qualifier->symbols;
+    if (qualifier->symbolIndex == NULL) return NULL;
+    current = qualifier->symbolIndex[hashId(id, len) & (qualifier->symbolIndexSize - 1)];
     while (current != NULL) {
-        valence = strncasecmp(current->id, id, (size_t)len);
-        if (valence > 0)
-            current = current->left;
-        else if (valence < 0)
-            current = current->right;
-        else if (current->id[len] == '\0')
-            break;
-        else
-            current = current->left;
+        if (strncasecmp(current->id, id, (size_t)len) == 0 && current->id[len] == '\0') break;
+        current = current->nextInChain;
     }
     return current;
 }
@@ -574,11 +618,6 @@ static void freeQualifier(Qualifier *qualifier) {
     free(qualifier);
 }
 
-static void freeSymbol(Symbol *symbol) {
-    free(symbol->id);
-    free(symbol);
-}
-
 u16 getRelativeAttribute(Section *section) {
     switch (section->type) {
     case SectionType_Mixed:
@@ -597,6 +636,43 @@ u16 getRelativeAttribute(Section *section) {
     }
 }
 
+/*
+**  findSection - find the first section of a module with a given id
+**
+**  The remaining sections with the id follow it through nextSameId.
+*/
+Section *findSection(Module *module, char *id, int len) {
+    Section *current;
+
+    if (module->sectionIndex == NULL) return NULL;
+    current = module->sectionIndex[hashId(id, len) & (module->sectionIndexSize - 1)];
+    while (current != NULL) {
+        if (strncasecmp(current->id, id, (size_t)len) == 0 && current->id[len] == '\0') break;
+        current = current->nextInChain;
+    }
+    return current;
+}
+
+/*
+**  hashId - compute a case-folded hash of an identifier
+*/
+u32 hashId(char *id, int len) {
+    char buf[MAX_NAME_LENGTH];
+    Fnv32_t hash;
+    int i;
+    int n;
+
+    hash = FNV1_32A_INIT;
+    while (len > 0) {
+        n = (len > MAX_NAME_LENGTH) ? MAX_NAME_LENGTH : len;
+        for (i = 0; i < n; i++) buf[i] = toupper(id[i]);
+        hash = fnv32a(buf, n, hash);
+        id += n;
+        len -= n;
+    }
+    return hash;
+}
+
 bool isAbsolute(Value *val) {
     return (val->attributes & (SYM_IMMOBILE|SYM_RELOCATABLE|SYM_EXTERNAL)) == 0;
 }
@@ -689,3 +765,85 @@ static void resetSection(Section *section) {
     section->wordBitPosCounter = 0;
     section->parcelBitPosCounter = 0;
 }
+
+/*
+**  resizeLiteralIndex - double the number of hash chains in a module's
+**                       literal index, and redistribute its literals
+*/
+static void resizeLiteralIndex(Module *module) {
+    Literal *literal;
+    Literal **slot;
+
+    if (module->literalIndex != NULL) free(module->literalIndex);
+    module->literalIndexSize = (module->literalIndexSize > 0) ? module->literalIndexSize * 2 : LITERAL_INDEX_SIZE;
+    module->literalIndex = (Literal **)allocate(module->literalIndexSize * sizeof(Literal *));
+    for (literal = module->literals; literal != NULL; literal = literal->next) {
+        slot = &module->literalIndex[literal->hash & (module->literalIndexSize - 1)];
+        literal->nextInChain = *slot;
+        *slot = literal;
+    }
+}
+
+/*
+**  resizeMicroIndex - double the number of hash chains in a module's micro
+**                     index, and redistribute its micros
+*/
+static void resizeMicroIndex(Module *module) {
+    u32 i;
+    Name *name;
+    Name *next;
+    Name **oldIndex;
+    u32 oldIndexSize;
+    Name **slot;
+
+    oldIndex = module->microIndex;
+    oldIndexSize = module->microIndexSize;
+    module->microIndexSize = (oldIndexSize > 0) ? oldIndexSize * 2 : MICRO_INDEX_SIZE;
+    module->microIndex = (Name **)allocate(module->microIndexSize * sizeof(Name *));
+    for (i = 0; i < oldIndexSize; i++) {
+        for (name = oldIndex[i]; name != NULL; name = next) {
+            next = name->nextInChain;
+            slot = &module->microIndex[hashId(name->id, strlen(name->id)) & (module->microIndexSize - 1)];
+            name->nextInChain = *slot;
+            *slot = name;
+        }
+    }
+    if (oldIndex != NULL) free(oldIndex);
+}
+
+/*
+**  resizeSectionIndex - double the number of hash chains in a module's
+**                       section index
+*/
+static void resizeSectionIndex(Module *module) {
+    Section *section;
+    Section **slot;
+
+    if (module->sectionIndex != NULL) free(module->sectionIndex);
+    module->sectionIndexSize = (module->sectionIndexSize > 0) ? module->sectionIndexSize * 2 : SECTION_INDEX_SIZE;
+    module->sectionIndex = (Section **)allocate(module->sectionIndexSize * sizeof(Section *));
+    for (section = module->firstSection; section != NULL; section = section->next) {
+        if (findSection(module, section->id, strlen(section->id)) != NULL) continue;
+        slot = &module->sectionIndex[hashId(section->id, strlen(section->id)) & (module->sectionIndexSize - 1)];
+        section->nextInChain = *slot;
+        *slot = section;
+    }
+}
+
+/*
+**  resizeSymbolIndex - double the number of hash chains in a qualifier's
+**                      symbol index, and redistribute its symbols
+*/
+static void resizeSymbolIndex(Qualifier *qualifier) {
+    Symbol *symbol;
+    Symbol **slot;
+
+    if (qualifier->symbolIndex != NULL) free(qualifier->symbolIndex);
+    qualifier->symbolIndexSize = (qualifier->symbolIndexSize > 0) ? qualifier->symbolIndexSize * 2 : SYMBOL_INDEX_SIZE;
+    qualifier->symbolIndex = (Symbol **)allocate(qualifier->symbolIndexSize * sizeof(Symbol *));
+    for (symbol = qualifier->firstSymbol; symbol != NULL; symbol = symbol->nextInQualifier) {
+        slot = &qualifier->symbolIndex[hashId(symbol->id, strlen(symbol->id)) & (qualifier->symbolIndexSize - 1)];
+        symbol->nextInChain = *slot;
+        *slot = symbol;
+    }
+}